@@ -1,5 +1,6 @@
 #include <string>
 #include <vector>
+#include <fstream>
 #include <iostream>
 #include <cstring>
 #include "getopt.h"
@@ -23,17 +24,75 @@ void options() {
        << "\t-o, --one  Use one_dataset mode (find similar for each sample not only in it's type dataset).\n"
        << "\t-p, --print  Print result to stdout.\n"
        << "\t-c, --config CONFIG Use parsed config of audiq\n"
+       << "\t-w, --sweep FILE Recommend for every weights triple of FILE (one 'w1 w2 w3' per line) in one pass,"
+       << " result file of each triple is named as if 'output_file' was not parsed ('output_file' replaces 'result' prefix).\n"
+       << "\t-b, --build Build global datasets from samples of 'folder_with_samples' with streaming build,"
+       << " loaded samples take at most 'memory_limit' megabytes of config.\n"
+       << "\t-k, --split SHARDS Split global datasets into SHARDS shards, which are searched with 'shards' or 'shard_sockets' options.\n"
+       << "\t-g, --knn-graphs Build kNN graphs of global datasets ('knn_neighbours' neighbours of config, 50 if it's 0)"
+       << " or update them with points added to global datasets.\n"
+       << "\t-m, --more-like SAMPLE Print the most similar samples to SAMPLE of global datasets (point or file name)"
+       << " from kNN graphs of global datasets, graphs must be built with --knn-graphs.\n"
+       << "\t-f, --file AUDIO_FILE Recommend for single AUDIO_FILE without creating user datasets,"
+       << " global datasets must be built by streaming build. Result is printed or written to 'output_file'.\n"
+       << "\t-F, --filter FILTER Recommend only samples matching FILTER 'LABEL=VALUE ... duration=MIN:MAX',"
+       << " labels are key, scale and highlevel classes (e.g. 'key=A scale=minor shot_or_loop=loop duration=1:8').\n"
+       << "\t-s, --serve SOCKET Load global datasets once and answer requests on unix socket SOCKET"
+       << " ('recommend USER_DATASET_NAME [one|many] [w1 w2 w3]' or 'extract FOLDER [one|many] [w1 w2 w3]').\n"
+       << "\t-P, --pipeline Recommend for every sample as soon as it's extracted, while next samples are extracted,"
+       << " without creating user datasets. Global datasets must be built by streaming build.\n"
        << "\t-n, --no-processing Don't extract descriptors or datasets creating"
        << " (use this option if you have datasets and want test audiq with different combinations of modes and weights,"
        << " expected that you have datasets).\n"
        << endl;
 }
 
+/**
+ * WeightName Formats 'weight' with the fewest decimals (at least one) which read back as the same value,
+ * so names of different weights never collide.
+ */
+string WeightName(float weight) {
+  char buf[64];
+  for ( int decimals = 1; decimals <= 9; ++decimals ) {
+    std::snprintf(buf, sizeof(buf), "%.*f", decimals, weight);
+    if ( std::stof(buf) == weight ) {
+      break;
+    }
+  }
+  return buf;
+}
+
+string ResultFileName(const string &prefix, const std::vector<float> &weights, const string &mode,
+                      const string &extension = "yaml") {
+  return prefix + "_" + WeightName(weights[0]) + "_" + WeightName(weights[1]) + "_" + WeightName(weights[2])
+         + "_" + mode + "_ds_mode." + extension;
+}
+
+/**
+ * ReadWeights Reads weights triples from 'file_name', one triple per line.
+ */
+std::vector<std::vector<float> > ReadWeights(const string &file_name) {
+  std::vector<std::vector<float> > sweep;
+  std::ifstream input(file_name);
+  std::vector<float> w(3);
+  while ( input >> w[0] >> w[1] >> w[2] ) {
+    sweep.push_back(w);
+  }
+  return sweep;
+}
+
 int main(int argc, char* argv[]) {
   string sounds_directory;
   string output_file;
   string audiq_profile;
+  string socket_path;
+  string sweep_file;
+  int shards = 0;
+  string more_like;
+  string query_file;
   bool print = false;
+  bool build = false;
+  bool knn_graphs = false;
   std::vector<float> weights = {1, 1, 1};
   int c;
   audiq::Audiq audiq_app = audiq::Audiq();
@@ -46,12 +105,21 @@ int main(int argc, char* argv[]) {
   {"one", no_argument, 0, 'o'},
   {"print", no_argument , 0, 'p'},
   {"no-processing", no_argument, 0, 'n'},
+  {"pipeline", no_argument, 0, 'P'},
+  {"build", no_argument, 0, 'b'},
   {"config", required_argument, 0, 'c'},
+  {"serve", required_argument, 0, 's'},
+  {"sweep", required_argument, 0, 'w'},
+  {"split", required_argument, 0, 'k'},
+  {"knn-graphs", no_argument, 0, 'g'},
+  {"more-like", required_argument, 0, 'm'},
+  {"file", required_argument, 0, 'f'},
+  {"filter", required_argument, 0, 'F'},
   {0, 0, 0, 0}
   };
   while ( true ) {
     int option_index = 0;
-    c = getopt_long(argc, argv, "hopnc:", long_options, &option_index);
+    c = getopt_long(argc, argv, "hopnPbgc:s:w:k:m:f:F:", long_options, &option_index);
     if (c == -1)
        break;
     switch (c) {
@@ -67,10 +135,74 @@ int main(int argc, char* argv[]) {
     case 'n':
       audiq_app.configure("only_recommendation", true);
       break;
+    case 'P':
+      audiq_app.configure("pipeline", true);
+      break;
+    case 'b':
+      build = true;
+      break;
+    case 'g':
+      knn_graphs = true;
+      break;
     case 'c':
       audiq_app.configure("audiq_profile", optarg);
       break;
+    case 's':
+      socket_path = optarg;
+      break;
+    case 'w':
+      sweep_file = optarg;
+      break;
+    case 'k':
+      shards = std::stoi(optarg);
+      break;
+    case 'm':
+      more_like = optarg;
+      break;
+    case 'f':
+      query_file = optarg;
+      break;
+    case 'F':
+      audiq_app.configure("filter", optarg);
+      break;
+    }
+  }
+  if ( shards > 0 ) {
+    audiq_app.SplitGlobalDataSet(shards);
+    return 0;
+  }
+  if ( knn_graphs ) {
+    if ( !audiq_app.BuildKnnGraphs() ) {
+      cout << "Can't build kNN graphs of global datasets" << endl;
+      exit(1);
+    }
+    return 0;
+  }
+  if ( !more_like.empty() ) {
+    audiq::audiq_similar result = audiq_app.MoreLikeThis(more_like);
+    if ( result.empty() ) {
+      cout << "There is no sample " << more_like << " in global datasets" << endl;
+      exit(1);
     }
+    audiq::PrintResult(result);
+    return 0;
+  }
+  if ( !query_file.empty() ) {
+    audiq::audiq_similar result = audiq_app.RecommendForFile(query_file);
+    if ( result.empty() ) {
+      cout << "Can't recommend for " << query_file << endl;
+      exit(1);
+    }
+    if ( optind < argc ) {
+      audiq::GenerateResultFile(result, argv[optind]);
+    } else {
+      audiq::PrintResult(result);
+    }
+    return 0;
+  }
+  if ( !socket_path.empty() ) {
+    audiq_app.Serve(socket_path);
+    return 0;
   }
   switch ( argc - optind ) {
     case 1:
@@ -108,18 +240,42 @@ int main(int argc, char* argv[]) {
     audiq_app.configure("audiq_profile", audiq_profile);
   }
 
+  if ( build ) {
+    audiq_app.BuildGlobalDataSets();
+    return 0;
+  }
+
+  if ( !sweep_file.empty() ) {
+    std::vector<std::vector<float> > sweep = ReadWeights(sweep_file);
+    if ( sweep.empty() ) {
+      cout << "There are no weights in " << sweep_file << endl;
+      exit(1);
+    }
+    audiq_app.Sweep(sweep);
+    std::vector<audiq::audiq_similar> results = audiq_app.GetSweepResult();
+    for ( size_t i = 0; i < sweep.size(); ++i ) {
+      if ( print ) {
+        audiq::PrintResult(results[i]);
+      }
+      audiq::GenerateResultFile(results[i], ResultFileName(output_file.empty() ? "result" : output_file,
+                                                           sweep[i], audiq_app.GetMode()));
+    }
+    return 0;
+  }
+
+  string format = audiq_app.GetResultFormat();
+  if ( output_file.empty() ) {
+    output_file = ResultFileName("result", weights, audiq_app.GetMode(),
+                                 format == "jsonl" ? "jsonl" : (format == "binary" ? "bin" : "yaml"));
+  }
+  if ( audiq_app.StartStreaming(output_file, print) ) {
+    return 0;
+  }
   audiq_app.Start();
   audiq::audiq_similar result = audiq_app.GetResult();
   if ( print ) {
     audiq::PrintResult(result);
   }
-  if ( output_file.empty() ) {
-    output_file = "result";
-    char buf[100];
-    std::snprintf(buf, 100, "%.01f_%.01f_%.01f", weights[0], weights[1], weights[2]);
-    output_file += "_" + string(buf) + "_" + audiq_app.GetMode() + "_ds_mode";
-    output_file += ".yaml";
-  }
   audiq::GenerateResultFile(result, output_file);
   return 0;
 }
@@ -1,21 +1,180 @@
 #include "audiq/audiq.h"
+#include <mutex>
+#include <thread>
+#include <exception>
 #include <ostream>
+#include <algorithm>
 #include "yaml.h"
 #include "audiq/audiq_util.h"
 #include "audiq/audiq_types.h"
+#include "audiq/audiq_dataset_union.h"
 #include "audiq/audiq_config.h"
 #include "audiq/audiq_similarity_model.h"
+#include "audiq/audiq_hnsw_index.h"
+#include "audiq/audiq_concurrency.h"
 
-audiq::audiq_similar audiq::Recommend(const bool one_dataset, const string &global_dataset_name,
-                                      const string &user_dataset_name, const vector<float> &weights) {
+namespace audiq {
+namespace {
+
+using gaia2::DataSet;
+
+/**
+ * RecommendType Recommends for user dataset of type 't' only with its global dataset (many dataset mode).
+ */
+void RecommendType(const string &t, const string &global_dataset_name,
+                   const string &user_dataset_name, const vector<float> &weights,
+                   const similarity::SearchOptions &options, const similarity::RecommendationHandler &handler) {
+  DataSet* user  = new DataSet;
+  DataSet* global = new DataSet;
+  user->load(QString::fromStdString(user_dataset_name + "_" + t + ".db"));
+  global->load(QString::fromStdString(global_dataset_name + "_" + t + ".db"));
+  if ( options.validate ) {
+    similarity::ValidateNativeMetric(global, weights);
+  }
+  vector<const similarity::HnswIndex*> indexes;
+  similarity::HnswIndex* index = nullptr;
+  if ( options.index ) {
+    index = similarity::LoadDataSetIndex(global_dataset_name + "_" + t);
+  }
+  if ( index ) {
+    indexes.push_back(index);
+  }
+  similarity::StreamSimilar(util::DataSetUnion({ global }), util::DataSetUnion({ user }), weights, options, indexes,
+                            handler);
+  delete index;
+  delete user;
+  delete global;
+}
+
+/**
+ * FitsMemory Returns true if datasets of all 'type_names' loaded at once fit into 'options.memory_limit'.
+ */
+bool FitsMemory(const vector<string> &type_names, const string &global_dataset_name,
+                const string &user_dataset_name, const similarity::SearchOptions &options) {
+  if ( options.memory_limit <= 0 ) {
+    return true;
+  }
+  uintmax_t bytes = 0;
+  for ( const auto &t : type_names ) {
+    bytes += filesystem::file_size(user_dataset_name + "_" + t + ".db");
+    bytes += filesystem::file_size(global_dataset_name + "_" + t + ".db");
+  }
+  return bytes * DATASET_MEMORY_FACTOR <= static_cast<uintmax_t>(options.memory_limit) << 20;
+}
+
+}  // namespace
+}  // namespace audiq
+
+void audiq::StreamRecommend(const bool one_dataset, const string &global_dataset_name,
+                            const string &user_dataset_name, const vector<float> &weights,
+                            const similarity::RecommendationHandler &handler,
+                            const similarity::SearchOptions &options) {
   using gaia2::DataSet;
-  gaia2::init();
+  util::InitGaia();
+  vector<string> user_types;
+  for ( auto t : types::TYPES ) {
+    // if such file don't exists => there are no samples of this type in user' samples
+    if ( filesystem::exists(user_dataset_name + "_" + t + ".db") ) {
+      user_types.push_back(t);
+    }
+  }
+  if ( !one_dataset ) {
+    if ( user_types.size() > 1 && FitsMemory(user_types, global_dataset_name, user_dataset_name, options) ) {
+      // types are independent, each of them gets its share of search threads
+      similarity::SearchOptions type_options = options;
+      type_options.threads = std::max(1, util::ThreadsNumber(options.threads) / static_cast<int>(user_types.size()));
+      // the first exception of workers, it's rethrown when all of them are joined
+      std::exception_ptr error;
+      std::mutex error_mutex;
+      vector<std::thread> workers;
+      for ( size_t i = 0; i < user_types.size(); ++i ) {
+        workers.emplace_back([&, i] {
+          try {
+            RecommendType(user_types[i], global_dataset_name, user_dataset_name, weights, type_options, handler);
+          }
+          catch ( ... ) {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if ( !error )
+              error = std::current_exception();
+          }
+        });
+      }
+      for ( auto &w : workers ) {
+        w.join();
+      }
+      if ( error ) {
+        std::rethrow_exception(error);
+      }
+    } else {
+      for ( const auto &t : user_types ) {
+        RecommendType(t, global_dataset_name, user_dataset_name, weights, options, handler);
+      }
+    }
+    return;
+  }
+
   vector<DataSet*> user_datasets;
   vector<DataSet*> global_datasets;
+  vector<const similarity::HnswIndex*> indexes;
+  for ( const auto &t : user_types ) {
+    DataSet* user  = new DataSet;
+    DataSet* global = new DataSet;
+    user->load(QString::fromStdString(user_dataset_name + "_" + t + ".db"));
+    global->load(QString::fromStdString(global_dataset_name + "_" + t + ".db"));
+    if ( options.validate ) {
+      similarity::ValidateNativeMetric(global, weights);
+    }
+    if ( options.index ) {
+      similarity::HnswIndex* index = similarity::LoadDataSetIndex(global_dataset_name + "_" + t);
+      if ( index ) {
+        indexes.push_back(index);
+      }
+    }
+    user_datasets.push_back(user);
+    global_datasets.push_back(global);
+  }
+  // datasets are searched in place, without copying them into one
+  util::DataSetUnion united_user_dataset(user_datasets);
+  util::DataSetUnion united_global_dataset(global_datasets);
+  similarity::StreamSimilar(united_global_dataset, united_user_dataset, weights, options, indexes, handler);
+  for ( auto index : indexes ) {
+    delete index;
+  }
+  for ( auto d : user_datasets ) {
+    delete d;
+  }
+  for ( auto d : global_datasets ) {
+    delete d;
+  }
+}
+
+audiq::audiq_similar audiq::Recommend(const bool one_dataset, const string &global_dataset_name,
+                                      const string &user_dataset_name, const vector<float> &weights,
+                                      const similarity::SearchOptions &options) {
   audiq_similar similar;
+  std::mutex mutex;
+  StreamRecommend(one_dataset, global_dataset_name, user_dataset_name, weights,
+                  [&](const string &target, const vector<similarity::Recommendation> &recommendations) {
+    std::lock_guard<std::mutex> lock(mutex);
+    vector<string> &samples = similar[target];
+    for ( const auto &r : recommendations ) {
+      samples.push_back(r.file_name);
+    }
+  }, options);
+  return similar;
+}
+
+std::vector<audiq::audiq_similar> audiq::RecommendSweep(const bool one_dataset, const string &global_dataset_name,
+                                                        const string &user_dataset_name,
+                                                        const vector<vector<float> > &weights,
+                                                        const similarity::SearchOptions &options) {
+  using gaia2::DataSet;
+  util::InitGaia();
+  vector<DataSet*> user_datasets;
+  vector<DataSet*> global_datasets;
+  vector<audiq_similar> similar(weights.size());
 
   for ( auto t : types::TYPES ) {
-    // if such file don't exists => there are no samples of this type in user' samples
     if ( !filesystem::exists(user_dataset_name + "_" + t + ".db") ) {
       continue;
     }
@@ -23,9 +182,15 @@ audiq::audiq_similar audiq::Recommend(const bool one_dataset, const string &glob
     DataSet* global = new DataSet;
     user->load(QString::fromStdString(user_dataset_name + "_" + t + ".db"));
     global->load(QString::fromStdString(global_dataset_name + "_" + t + ".db"));
+    if ( options.validate ) {
+      similarity::ValidateNativeMetric(global, weights);
+    }
     if ( !one_dataset ) {
-      map<string, vector<string> > tmp = similarity::FindSimilar(global, user, weights);
-      similar.insert(tmp.begin(), tmp.end());
+      vector<audiq_similar> tmp = similarity::FindSimilarSweep(util::DataSetUnion({ global }),
+                                                               util::DataSetUnion({ user }), weights, options);
+      for ( size_t w = 0; w < weights.size(); ++w ) {
+        similar[w].insert(tmp[w].begin(), tmp[w].end());
+      }
       delete user;
       delete global;
       continue;
@@ -33,20 +198,16 @@ audiq::audiq_similar audiq::Recommend(const bool one_dataset, const string &glob
     user_datasets.push_back(user);
     global_datasets.push_back(global);
   }
-  if ( !one_dataset ) {
-    return similar;
+  if ( one_dataset && !user_datasets.empty() ) {
+    similar = similarity::FindSimilarSweep(util::DataSetUnion(global_datasets), util::DataSetUnion(user_datasets),
+                                           weights, options);
   }
-  DataSet* united_user_dataset = util::SumDataSets(user_datasets);
-  DataSet* united_global_dataset = util::SumDataSets(global_datasets);
   for ( auto d : user_datasets ) {
     delete d;
   }
   for ( auto d : global_datasets ) {
     delete d;
   }
-  similar = similarity::FindSimilar(united_global_dataset, united_user_dataset, weights);
-  delete united_global_dataset;
-  delete united_user_dataset;
   return similar;
 }
 
@@ -60,17 +221,22 @@ void audiq::PrintResult(const audiq_similar &similars) {
   }
 }
 
-void audiq::GenerateResultFile(const audiq_similar &similars,
-                               const std::string &result_name) {
+namespace {
+
+int AppendToString(void *data, unsigned char *buffer, size_t size) {
+  static_cast<std::string*>(data)->append(reinterpret_cast<char*>(buffer), size);
+  return 1;
+}
+
+/**
+ * EmitResult Dumps 'similars' with opened 'emitter', emitter is deleted after that.
+ */
+void EmitResult(yaml_emitter_t *emitter, const audiq::audiq_similar &similars) {
   // Ugly C code for dumping map
-  yaml_emitter_t emitter;
   yaml_document_t output_document;
   int sequence, item, mapping, key, seq;
-  yaml_emitter_initialize(&emitter);
-  FILE *output = fopen(result_name.c_str(), "wb");
   yaml_document_initialize(&output_document, NULL, NULL, NULL, 0, 0);
-  yaml_emitter_set_output_file(&emitter, output);
-  yaml_emitter_open(&emitter);
+  yaml_emitter_open(emitter);
   const yaml_char_t* tmp;
   seq = yaml_document_add_sequence(&output_document, NULL,
                                         YAML_BLOCK_SEQUENCE_STYLE);
@@ -92,8 +258,28 @@ void audiq::GenerateResultFile(const audiq_similar &similars,
     }
     yaml_document_append_mapping_pair(&output_document, mapping, key, sequence);
   }
-  yaml_emitter_dump(&emitter, &output_document);
+  yaml_emitter_dump(emitter, &output_document);
   yaml_document_delete(&output_document);
-  yaml_emitter_delete(&emitter);
+  yaml_emitter_delete(emitter);
 }
 
+}  // namespace
+
+void audiq::GenerateResultFile(const audiq_similar &similars,
+                               const std::string &result_name) {
+  yaml_emitter_t emitter;
+  yaml_emitter_initialize(&emitter);
+  FILE *output = fopen(result_name.c_str(), "wb");
+  yaml_emitter_set_output_file(&emitter, output);
+  EmitResult(&emitter, similars);
+  fclose(output);
+}
+
+std::string audiq::ResultToYaml(const audiq_similar &similars) {
+  std::string result;
+  yaml_emitter_t emitter;
+  yaml_emitter_initialize(&emitter);
+  yaml_emitter_set_output(&emitter, AppendToString, &result);
+  EmitResult(&emitter, similars);
+  return result;
+}
@@ -5,6 +5,8 @@
 #include <string>
 #include <vector>
 #include "audiq/audiq_config.h"
+#include "audiq/audiq_search_options.h"
+#include "audiq/audiq_similarity_model.h"
 
 namespace audiq {
 typedef std::map<std::string, std::vector<std::string> > audiq_similar;
@@ -12,7 +14,28 @@ typedef std::map<std::string, std::vector<std::string> > audiq_similar;
 audiq_similar Recommend(const bool one_dataset,
                         const std::string &global_dataset_name,
                         const std::string &user_dataset_name,
-                        const std::vector<float> &weights);
+                        const std::vector<float> &weights,
+                        const similarity::SearchOptions &options = similarity::SearchOptions());
+/**
+ * StreamRecommend Same as Recommend, but recommendations of every user sample are passed to 'handler'
+ * as soon as they are found (see similarity::StreamSimilar, audiq::ResultSink). In many dataset mode
+ * types may be searched concurrently, so 'handler' must be thread-safe.
+ */
+void StreamRecommend(const bool one_dataset,
+                     const std::string &global_dataset_name,
+                     const std::string &user_dataset_name,
+                     const std::vector<float> &weights,
+                     const similarity::RecommendationHandler &handler,
+                     const similarity::SearchOptions &options = similarity::SearchOptions());
+/**
+ * RecommendSweep Same as Recommend, but for every weights triple of 'weights' in one pass
+ * (see similarity::FindSimilarSweep), returns result of every triple in order of 'weights'.
+ */
+std::vector<audiq_similar> RecommendSweep(const bool one_dataset,
+                                          const std::string &global_dataset_name,
+                                          const std::string &user_dataset_name,
+                                          const std::vector<std::vector<float> > &weights,
+                                          const similarity::SearchOptions &options = similarity::SearchOptions());
 /**
  * PrintResult Prints result to stdout.
  */
@@ -22,6 +45,10 @@ void PrintResult(const audiq_similar &similars);
  * GenerateResultFile Generates result YAML file, with key - "target" sample id and sequnce of ids corresponding to it.
  */
 void GenerateResultFile(const audiq_similar &similars, const std::string &result_name);
+/**
+ * ResultToYaml Returns the same YAML as GenerateResultFile writes.
+ */
+std::string ResultToYaml(const audiq_similar &similars);
 
 namespace processing {
 
@@ -0,0 +1,123 @@
+#ifndef PROJECT_AUDIQ_ALIGNED_BLOCK_H
+#define PROJECT_AUDIQ_ALIGNED_BLOCK_H
+
+#include <cstdlib>
+#include <cstring>
+#include <cstddef>
+#include <new>
+#include <utility>
+
+#define BLOCK_ALIGNMENT 64
+
+namespace audiq {
+namespace similarity {
+
+/**
+ * @brief AlignedBlock Row-major 'rows' x 'dimension' block of values, aligned to BLOCK_ALIGNMENT bytes.
+ * Every row is zero-padded up to 'stride' values, so each row starts on an aligned boundary
+ * and kernels may safely read whole vector registers up to the stride.
+ */
+template <typename T>
+class AlignedBlock {
+ public:
+  AlignedBlock() : _data(nullptr), _rows(0), _dimension(0), _stride(0), _owned(true) {}
+
+  AlignedBlock(int rows, int dimension) : AlignedBlock() {
+    Resize(rows, dimension);
+  }
+
+  ~AlignedBlock() {
+    Free();
+  }
+
+  AlignedBlock(const AlignedBlock&) = delete;
+  AlignedBlock& operator=(const AlignedBlock&) = delete;
+
+  AlignedBlock(AlignedBlock &&other) : AlignedBlock() {
+    Swap(other);
+  }
+
+  AlignedBlock& operator=(AlignedBlock &&other) {
+    Swap(other);
+    return *this;
+  }
+
+  /**
+   * Resize Reallocates block, all values (including padding) are set to zero.
+   */
+  void Resize(int rows, int dimension) {
+    Free();
+    _data = nullptr;
+    _rows = rows;
+    _dimension = dimension;
+    _stride = PaddedDimension(dimension);
+    if ( Bytes() == 0 ) {
+      return;
+    }
+    if ( posix_memalign(reinterpret_cast<void**>(&_data), BLOCK_ALIGNMENT, Bytes()) != 0 ) {
+      throw std::bad_alloc();
+    }
+    std::memset(_data, 0, Bytes());
+  }
+
+  /**
+   * View Makes block a read-only view of external 'data' with 'rows' x 'dimension' values laid out with
+   * the same stride (e.g. block written to a mapped file). Viewed memory isn't freed by block and must outlive it.
+   */
+  void View(const T *data, int rows, int dimension) {
+    Free();
+    _data = const_cast<T*>(data);
+    _rows = rows;
+    _dimension = dimension;
+    _stride = PaddedDimension(dimension);
+    _owned = false;
+  }
+  /**
+   * Owned Returns false if block is a view of external memory.
+   */
+  bool Owned() const { return _owned; }
+
+  /**
+   * PaddedDimension Stride of rows with 'dimension' values.
+   */
+  static constexpr int PaddedDimension(int dimension) {
+    return (dimension + BLOCK_ALIGNMENT / sizeof(T) - 1) / (BLOCK_ALIGNMENT / sizeof(T))
+           * (BLOCK_ALIGNMENT / sizeof(T));
+  }
+
+  T* Row(int i) { return _data + static_cast<size_t>(i) * _stride; }
+  const T* Row(int i) const { return _data + static_cast<size_t>(i) * _stride; }
+  T* Data() { return _data; }
+  const T* Data() const { return _data; }
+
+  int Rows() const { return _rows; }
+  int Dimension() const { return _dimension; }
+  int Stride() const { return _stride; }
+  size_t Bytes() const { return static_cast<size_t>(_rows) * _stride * sizeof(T); }
+
+ private:
+  void Free() {
+    if ( _owned ) {
+      std::free(_data);
+    }
+    _owned = true;
+  }
+
+  void Swap(AlignedBlock &other) {
+    std::swap(_data, other._data);
+    std::swap(_rows, other._rows);
+    std::swap(_dimension, other._dimension);
+    std::swap(_stride, other._stride);
+    std::swap(_owned, other._owned);
+  }
+
+  T* _data;
+  int _rows;
+  int _dimension;
+  int _stride;
+  bool _owned;
+};
+
+}  // namespace similarity
+}  // namespace audiq
+#endif  // PROJECT_AUDIQ_ALIGNED_BLOCK_H
@@ -0,0 +1,109 @@
+#ifndef PROJECT_AUDIQ_BINARY_IO_H
+#define PROJECT_AUDIQ_BINARY_IO_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+
+// sizes read from files above this number of bytes are checked against the rest of file before allocation
+#define BINARY_CHECKED_SIZE (1 << 20)
+
+namespace audiq {
+namespace util {
+
+/**
+ * Helpers for audiq binary files (feature stores, indexes). Values are written in host byte order.
+ */
+template <typename T>
+void WriteValue(std::ostream &out, const T &value) {
+  out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+bool ReadValue(std::istream &in, T *value) {
+  in.read(reinterpret_cast<char*>(value), sizeof(T));
+  return static_cast<bool>(in);
+}
+
+/**
+ * FitsStream Returns true if 'bytes' can still be read from 'in': small sizes are always accepted,
+ * larger ones are compared with the rest of seekable stream, so corrupt size fields don't cause huge allocations.
+ */
+inline bool FitsStream(std::istream &in, uint64_t bytes) {
+  if ( bytes <= BINARY_CHECKED_SIZE ) {
+    return true;
+  }
+  std::streampos position = in.tellg();
+  if ( position < 0 ) {
+    in.clear();
+    return true;
+  }
+  in.seekg(0, std::ios::end);
+  std::streampos end = in.tellg();
+  in.seekg(position);
+  return end >= position && static_cast<uint64_t>(end - position) >= bytes;
+}
+
+template <typename T>
+void WriteArray(std::ostream &out, const T *values, size_t size) {
+  out.write(reinterpret_cast<const char*>(values), size * sizeof(T));
+}
+
+template <typename T>
+bool ReadArray(std::istream &in, T *values, size_t size) {
+  in.read(reinterpret_cast<char*>(values), size * sizeof(T));
+  return static_cast<bool>(in);
+}
+
+template <typename T>
+void WriteVector(std::ostream &out, const std::vector<T> &values) {
+  WriteValue<uint64_t>(out, values.size());
+  WriteArray(out, values.data(), values.size());
+}
+
+template <typename T>
+bool ReadVector(std::istream &in, std::vector<T> *values) {
+  uint64_t size;
+  if ( !ReadValue(in, &size) || size > UINT64_MAX / sizeof(T) || !FitsStream(in, size * sizeof(T)) ) {
+    return false;
+  }
+  values->resize(size);
+  return ReadArray(in, values->data(), size);
+}
+
+inline void WriteString(std::ostream &out, const std::string &value) {
+  WriteValue<uint32_t>(out, value.size());
+  out.write(value.data(), value.size());
+}
+
+inline bool ReadString(std::istream &in, std::string *value) {
+  uint32_t size;
+  if ( !ReadValue(in, &size) || !FitsStream(in, size) ) {
+    return false;
+  }
+  value->resize(size);
+  in.read(&(*value)[0], size);
+  return static_cast<bool>(in);
+}
+
+/**
+ * WriteHeader Writes 4 bytes file 'magic' and format 'version'.
+ */
+inline void WriteHeader(std::ostream &out, const char *magic, uint32_t version) {
+  out.write(magic, 4);
+  WriteValue(out, version);
+}
+
+inline bool ReadHeader(std::istream &in, const char *magic, uint32_t version) {
+  char buffer[4];
+  uint32_t file_version;
+  in.read(buffer, 4);
+  return in && std::string(buffer, 4) == std::string(magic, 4)
+         && ReadValue(in, &file_version) && file_version == version;
+}
+
+}  // namespace util
+}  // namespace audiq
+#endif  // PROJECT_AUDIQ_BINARY_IO_H
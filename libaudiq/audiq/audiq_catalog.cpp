@@ -0,0 +1,245 @@
+#include "audiq/audiq_catalog.h"
+#include <memory>
+#include <iostream>
+#include "gaia2/gaia.h"
+#include "audiq/audiq_util.h"
+#include "audiq/audiq_config.h"
+#include "audiq/audiq_dataset_union.h"
+#include "audiq/audiq_similarity_model.h"
+#include "audiq/audiq_quantized_store.h"
+#include "audiq/audiq_duplicates.h"
+#include "audiq/audiq_hnsw_index.h"
+#include "audiq/audiq_knn_graph.h"
+#include "audiq/audiq_metadata_index.h"
+
+namespace audiq {
+namespace similarity {
+
+namespace {
+
+/**
+ * HasDescriptors Returns true if 'points' have all highlevel descriptors of catalog store.
+ */
+bool HasDescriptors(const util::DataSetUnion &points, const QStringList &highlevel_names) {
+  QStringList names = HighlevelDescriptors(points);
+  for ( const auto &name : highlevel_names ) {
+    if ( !names.contains(name) ) {
+      std::cout << "User dataset has no descriptor " << name.toStdString() << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * SameHighlevelNames Returns true if all 'stores' have the same highlevel names.
+ */
+bool SameHighlevelNames(const vector<FeatureStore*> &stores) {
+  for ( auto s : stores ) {
+    if ( s->HighlevelNames() != stores[0]->HighlevelNames() ) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+Catalog::~Catalog() {
+  Clear();
+}
+
+void Catalog::Clear() {
+  for ( auto &pair : _types ) {
+    delete pair.second.metadata;
+    delete pair.second.quantized;
+    delete pair.second.store;
+  }
+  _types.clear();
+  delete _united.metadata;
+  delete _united.quantized;
+  delete _united.store;
+  _united = Part();
+  for ( auto index : _indexes ) {
+    delete index;
+  }
+  _indexes.clear();
+  for ( auto &pair : _graphs ) {
+    delete pair.second;
+  }
+  _graphs.clear();
+}
+
+void Catalog::SetPart(Part *part, FeatureStore *store, const SearchOptions &options) {
+  part->store = store;
+  if ( options.collapse_duplicates ) {
+    std::cout << ClusterDuplicates(store) << " near-duplicates of " << store->Size() << " samples are collapsed"
+              << std::endl;
+  }
+  part->metadata = new MetadataIndex(*store);
+  if ( options.quantization != QUANTIZATION_NONE ) {
+    part->quantized = new QuantizedStore(*store, options.quantization, options.threads);
+    // full rows are read only by rerank (and exact search of selective filters)
+    if ( !store->PageDescriptors() ) {
+      std::cout << "Can't page descriptors, they are kept in memory" << std::endl;
+    }
+  }
+}
+
+bool Catalog::Load(const string &global_dataset_name, const SearchOptions &options) {
+  util::InitGaia();
+  Clear();
+  _name = global_dataset_name;
+  vector<DataSet*> datasets;
+  vector<string> types;
+  vector<FeatureStore*> stores;
+  for ( auto t : types::TYPES ) {
+    string name = global_dataset_name + "_" + t;
+    if ( !filesystem::exists(name + ".db") ) {
+      continue;
+    }
+    DataSet* dataset = new DataSet;
+    dataset->load(QString::fromStdString(name + ".db"));
+    if ( options.validate ) {
+      // weights of requests aren't known yet, every component is validated with weight 1
+      ValidateNativeMetric(dataset, vector<float>(3, 1.0));
+    }
+    datasets.push_back(dataset);
+    types.push_back(t);
+    stores.push_back(BuildFeatureStore(dataset));
+    if ( options.index ) {
+      HnswIndex* index = LoadDataSetIndex(name);
+      if ( index ) {
+        _indexes.push_back(index);
+        _types[t].indexes.push_back(index);
+        _united.indexes.push_back(index);
+      }
+    }
+  }
+  if ( datasets.empty() ) {
+    return false;
+  }
+  if ( SameHighlevelNames(stores) ) {
+    // united store is a concatenation of type stores, so they share its descriptors instead of keeping a copy
+    SetPart(&_united, ConcatenateFeatureStores(vector<const FeatureStore*>(stores.begin(), stores.end())), options);
+    int row = 0;
+    for ( auto s : stores ) {
+      s->ShareDescriptors(*_united.store, row);
+      row += s->Size();
+    }
+  } else {
+    util::DataSetUnion united(datasets);
+    SetPart(&_united, BuildFeatureStore(united, HighlevelDescriptors(united)), options);
+  }
+  for ( size_t i = 0; i < types.size(); ++i ) {
+    SetPart(&_types[types[i]], stores[i], options);
+  }
+  for ( auto d : datasets ) {
+    delete d;
+  }
+  return true;
+}
+
+types::audiq_similar Catalog::Recommend(bool one_dataset, const string &user_dataset_name,
+                                        const vector<float> &weights, const SearchOptions &options) const {
+  return SimilarNames(Neighbours(one_dataset, user_dataset_name, weights, options));
+}
+
+types::audiq_neighbours Catalog::Neighbours(bool one_dataset, const string &user_dataset_name,
+                                            const vector<float> &weights, const SearchOptions &options) const {
+  types::audiq_neighbours similar;
+  ForEachQueries(one_dataset, user_dataset_name, [&](const Part &part, const FeatureStore &queries) {
+    types::audiq_neighbours tmp = Search(part, queries, weights, options);
+    similar.insert(tmp.begin(), tmp.end());
+  });
+  return similar;
+}
+
+void Catalog::Stream(bool one_dataset, const string &user_dataset_name, const vector<float> &weights,
+                     const SearchOptions &options, const RecommendationHandler &handler) const {
+  ForEachQueries(one_dataset, user_dataset_name, [&](const Part &part, const FeatureStore &queries) {
+    const QuantizedStore* quantized = options.quantization != QUANTIZATION_NONE ? part.quantized : nullptr;
+    StreamSimilar(*part.store, queries, quantized, options.index ? part.indexes : vector<const HnswIndex*>(),
+                  weights, options, handler, part.metadata);
+  });
+}
+
+void Catalog::ForEachQueries(bool one_dataset, const string &user_dataset_name,
+                             const std::function<void(const Part&, const FeatureStore&)> &search) const {
+  // datasets and queries are owned here, so a failed request doesn't leak them
+  vector<std::unique_ptr<DataSet> > user_datasets;
+  for ( const auto &pair : _types ) {
+    string name = user_dataset_name + "_" + pair.first + ".db";
+    if ( !filesystem::exists(name) ) {
+      continue;
+    }
+    std::unique_ptr<DataSet> user(new DataSet);
+    user->load(QString::fromStdString(name));
+    if ( one_dataset ) {
+      user_datasets.push_back(std::move(user));
+      continue;
+    }
+    util::DataSetUnion points({ user.get() });
+    if ( HasDescriptors(points, pair.second.store->HighlevelNames()) ) {
+      std::unique_ptr<FeatureStore> queries(BuildFeatureStore(points, pair.second.store->HighlevelNames()));
+      search(pair.second, *queries);
+    }
+  }
+  if ( one_dataset && !user_datasets.empty() ) {
+    vector<DataSet*> datasets;
+    for ( const auto &d : user_datasets ) {
+      datasets.push_back(d.get());
+    }
+    util::DataSetUnion points(datasets);
+    if ( HasDescriptors(points, _united.store->HighlevelNames()) ) {
+      std::unique_ptr<FeatureStore> queries(BuildFeatureStore(points, _united.store->HighlevelNames()));
+      search(_united, *queries);
+    }
+  }
+}
+
+types::audiq_neighbours Catalog::Search(const Part &part, const FeatureStore &queries,
+                                        const vector<float> &weights, const SearchOptions &options) const {
+  const QuantizedStore* quantized = options.quantization != QUANTIZATION_NONE ? part.quantized : nullptr;
+  return FindNeighbours(*part.store, queries, quantized,
+                        options.index ? part.indexes : vector<const HnswIndex*>(), weights, options, part.metadata);
+}
+
+bool Catalog::LoadKnnGraphs(int k, const vector<float> &weights) {
+  for ( const auto &pair : _types ) {
+    if ( _graphs.count(pair.first) ) {
+      continue;
+    }
+    KnnGraph* graph = LoadDataSetKnnGraph(_name + "_" + pair.first, k, MetricWeights(weights));
+    if ( !graph ) {
+      return false;
+    }
+    _graphs[pair.first] = graph;
+  }
+  return true;
+}
+
+types::audiq_neighbours Catalog::MoreLikeThis(const string &sample, int quantity) const {
+  types::audiq_neighbours similar;
+  for ( const auto &pair : _graphs ) {
+    vector<std::pair<string, float> > neighbours = pair.second->Lookup(sample, quantity);
+    if ( !neighbours.empty() ) {
+      similar[sample] = neighbours;
+      break;
+    }
+  }
+  return similar;
+}
+
+size_t Catalog::Bytes() const {
+  size_t bytes = _united.store ? _united.store->Bytes() + _united.metadata->Bytes() : 0;
+  bytes += _united.quantized ? _united.quantized->Bytes() : 0;
+  for ( const auto &pair : _types ) {
+    bytes += pair.second.store->Bytes() + pair.second.metadata->Bytes();
+    bytes += pair.second.quantized ? pair.second.quantized->Bytes() : 0;
+  }
+  return bytes;
+}
+
+}  // namespace similarity
+}  // namespace audiq
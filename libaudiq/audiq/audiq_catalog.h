@@ -0,0 +1,104 @@
+#ifndef PROJECT_AUDIQ_CATALOG_H
+#define PROJECT_AUDIQ_CATALOG_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <functional>
+#include "gaia2/dataset.h"
+#include "audiq/audiq_types.h"
+#include "audiq/audiq_search_options.h"
+#include "audiq/audiq_feature_store.h"
+#include "audiq/audiq_similarity_model.h"
+
+namespace audiq {
+namespace similarity {
+
+using gaia2::DataSet;
+
+class HnswIndex;
+class KnnGraph;
+class QuantizedStore;
+class MetadataIndex;
+
+/**
+ * @brief Catalog Global datasets kept in memory for repeated recommendations:
+ * feature store of every type dataset and one united store for one dataset mode (type stores share descriptors
+ * of united store if they have the same highlevel descriptors), with quantized copies and HNSW indexes
+ * if search options of Load require them, and metadata indexes for filtered requests.
+ * Descriptors of quantized stores are paged (see FeatureStore::PageDescriptors).
+ * Catalog isn't changed after Load, so it may serve concurrent requests.
+ */
+class Catalog {
+ public:
+  Catalog() {}
+  ~Catalog();
+
+  Catalog(const Catalog&) = delete;
+  Catalog& operator=(const Catalog&) = delete;
+
+  /**
+   * Load Loads datasets 'global_dataset_name'_TYPE.db, returns false if there are no such datasets.
+   */
+  bool Load(const string &global_dataset_name, const SearchOptions &options);
+  /**
+   * Recommend Same as audiq::Recommend, but global datasets are taken from catalog.
+   * Quantized search and index are used only if they were loaded.
+   */
+  types::audiq_similar Recommend(bool one_dataset, const string &user_dataset_name,
+                                 const vector<float> &weights, const SearchOptions &options) const;
+  /**
+   * Neighbours Same as Recommend, but returns distances of similar samples too.
+   */
+  types::audiq_neighbours Neighbours(bool one_dataset, const string &user_dataset_name,
+                                     const vector<float> &weights, const SearchOptions &options) const;
+  /**
+   * Stream Same as Recommend, but similar samples of every user sample are passed to 'handler'
+   * as soon as they are found (see StreamSimilar).
+   */
+  void Stream(bool one_dataset, const string &user_dataset_name, const vector<float> &weights,
+              const SearchOptions &options, const RecommendationHandler &handler) const;
+
+  /**
+   * LoadKnnGraphs Loads kNN graphs of loaded datasets, see LoadDataSetKnnGraph (graphs aren't built by catalog,
+   * see BuildDataSetKnnGraph). Returns false if some graph is missing or outdated.
+   */
+  bool LoadKnnGraphs(int k, const vector<float> &weights);
+  /**
+   * MoreLikeThis Returns at most 'quantity' neighbours of sample of global datasets from kNN graphs,
+   * 'sample' is point name or file name. Result is empty if there is no such sample or graphs weren't loaded.
+   */
+  types::audiq_neighbours MoreLikeThis(const string &sample, int quantity) const;
+
+  size_t Bytes() const;
+
+ private:
+  struct Part {
+    Part() : store(nullptr), quantized(nullptr), metadata(nullptr) {}
+    FeatureStore* store;
+    QuantizedStore* quantized;
+    MetadataIndex* metadata;
+    vector<const HnswIndex*> indexes;
+  };
+
+  void Clear();
+  void SetPart(Part *part, FeatureStore *store, const SearchOptions &options);
+  /**
+   * ForEachQueries Builds queries of user datasets 'user_dataset_name'_TYPE.db and calls 'search' with them
+   * and the part of catalog they are searched in.
+   */
+  void ForEachQueries(bool one_dataset, const string &user_dataset_name,
+                      const std::function<void(const Part&, const FeatureStore&)> &search) const;
+  types::audiq_neighbours Search(const Part &part, const FeatureStore &queries,
+                                 const vector<float> &weights, const SearchOptions &options) const;
+
+  map<string, Part> _types;
+  Part _united;
+  vector<HnswIndex*> _indexes;
+  string _name;
+  map<string, KnnGraph*> _graphs;
+};
+
+}  // namespace similarity
+}  // namespace audiq
+#endif  // PROJECT_AUDIQ_CATALOG_H
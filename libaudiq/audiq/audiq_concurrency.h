@@ -0,0 +1,123 @@
+#ifndef PROJECT_AUDIQ_CONCURRENCY_H
+#define PROJECT_AUDIQ_CONCURRENCY_H
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <condition_variable>
+
+namespace audiq {
+namespace util {
+
+/**
+ * @brief BlockingQueue Bounded multi-producer multi-consumer queue.
+ * Push blocks while queue is full, Pop blocks while queue is empty and not closed.
+ */
+template <typename T>
+class BlockingQueue {
+ public:
+  explicit BlockingQueue(size_t capacity = 0) : _capacity(capacity), _closed(false) {}
+
+  BlockingQueue(const BlockingQueue&) = delete;
+  BlockingQueue& operator=(const BlockingQueue&) = delete;
+
+  /**
+   * Push Adds 'value' to queue, returns false if queue was closed.
+   */
+  bool Push(T value) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _not_full.wait(lock, [this] { return _closed || _capacity == 0 || _queue.size() < _capacity; });
+    if ( _closed ) {
+      return false;
+    }
+    _queue.push_back(std::move(value));
+    _not_empty.notify_one();
+    return true;
+  }
+
+  /**
+   * Pop Takes the first value of queue, returns false if queue is closed and empty.
+   */
+  bool Pop(T *value) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _not_empty.wait(lock, [this] { return _closed || !_queue.empty(); });
+    if ( _queue.empty() ) {
+      return false;
+    }
+    *value = std::move(_queue.front());
+    _queue.pop_front();
+    _not_full.notify_one();
+    return true;
+  }
+
+  /**
+   * Close Wakes up all waiting threads, values left in queue still can be popped.
+   */
+  void Close() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _closed = true;
+    _not_empty.notify_all();
+    _not_full.notify_all();
+  }
+
+ private:
+  size_t _capacity;
+  bool _closed;
+  std::deque<T> _queue;
+  std::mutex _mutex;
+  std::condition_variable _not_empty;
+  std::condition_variable _not_full;
+};
+
+/**
+ * ThreadsNumber Returns 'threads' if it's positive, otherwise number of hardware threads.
+ */
+inline int ThreadsNumber(int threads) {
+  if ( threads > 0 ) {
+    return threads;
+  }
+  return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+}
+
+/**
+ * @brief ThreadPool Fixed number of threads running submitted tasks in submission order.
+ * Destructor waits for all submitted tasks.
+ */
+class ThreadPool {
+ public:
+  explicit ThreadPool(int threads = 0) {
+    for ( int t = 0; t < ThreadsNumber(threads); ++t ) {
+      _workers.emplace_back([this] {
+        std::function<void()> task;
+        while ( _tasks.Pop(&task) ) {
+          task();
+        }
+      });
+    }
+  }
+
+  ~ThreadPool() {
+    _tasks.Close();
+    for ( auto &w : _workers ) {
+      w.join();
+    }
+  }
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  void Submit(std::function<void()> task) {
+    _tasks.Push(std::move(task));
+  }
+
+ private:
+  BlockingQueue<std::function<void()> > _tasks;
+  std::vector<std::thread> _workers;
+};
+
+}  // namespace util
+}  // namespace audiq
+#endif  // PROJECT_AUDIQ_CONCURRENCY_H
@@ -13,6 +13,21 @@
 #define FILENAME_DESCRIPTOR "metadata.tags.file_name"
 #define MD5_DESCRIPTOR      "metadata.audio_properties.md5_encoded"
 #define TYPE_DESCRIPTOR     "highlevel.type.value"
+#define PCA_DESCRIPTOR      "pca"
+#define MFCC_MEAN           "lowlevel.mfcc.mean"
+#define MFCC_COV            "lowlevel.mfcc.cov"
+#define MFCC_ICOV           "lowlevel.mfcc.icov"
+#define HIGHLEVEL_PROBABILITIES "highlevel.*.all.*"
+// metadata of samples used by search filters (see SampleFilter)
+#define DURATION_DESCRIPTOR "metadata.audio_properties.length"
+#define KEY_DESCRIPTORS     "tonal.key*.key"
+#define SCALE_DESCRIPTORS   "tonal.key*.scale"
+#define CLASS_DESCRIPTORS   "highlevel.*.value"
+
+#define PCA_DIMENSION       25
+#define MFCC_DIMENSION      13
+// packed upper triangle of MFCC matrix, MFCC vector and one scalar (see FeatureStore)
+#define MFCC_TERMS          (MFCC_DIMENSION * (MFCC_DIMENSION + 1) / 2 + MFCC_DIMENSION + 1)
 
 #define SAMPLES_PER_DATASET 2000
 #define QUANTITY            30
@@ -0,0 +1,60 @@
+#include "audiq/audiq_dataset_union.h"
+
+namespace audiq {
+namespace util {
+
+DataSetUnion::DataSetUnion(const vector<DataSet*> &datasets) {
+  for ( auto d : datasets ) {
+    Add(d);
+  }
+}
+
+void DataSetUnion::Add(const DataSet *dataset) {
+  _datasets.push_back(dataset);
+  for ( int i = 0; i < dataset->size(); ++i ) {
+    const Point* point = dataset->at(i);
+    if ( _names.contains(point->name()) ) {
+      continue;
+    }
+    _names.insert(point->name());
+    _points.push_back(point);
+  }
+}
+
+void DataSetUnion::Add(const DataSetUnion &other) {
+  for ( auto d : other.DataSets() ) {
+    Add(d);
+  }
+}
+
+QStringList DataSetUnion::PointNames() const {
+  QStringList names;
+  for ( auto p : _points ) {
+    names << p->name();
+  }
+  return names;
+}
+
+QStringList DataSetUnion::CommonDescriptors(const QStringList &patterns) const {
+  QStringList common;
+  if ( _datasets.empty() ) {
+    return common;
+  }
+  vector<QSet<QString> > others;
+  for ( int i = 1; i < static_cast<int>(_datasets.size()); ++i ) {
+    others.push_back(_datasets[i]->layout().descriptorNames(gaia2::UndefinedType, patterns).toSet());
+  }
+  for ( auto name : _datasets[0]->layout().descriptorNames(gaia2::UndefinedType, patterns) ) {
+    bool everywhere = true;
+    for ( const auto &names : others ) {
+      everywhere = everywhere && names.contains(name);
+    }
+    if ( everywhere ) {
+      common << name;
+    }
+  }
+  return common;
+}
+
+}  // namespace util
+}  // namespace audiq
@@ -0,0 +1,50 @@
+#ifndef PROJECT_AUDIQ_DATASET_UNION_H
+#define PROJECT_AUDIQ_DATASET_UNION_H
+
+#include <vector>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include "gaia2/point.h"
+#include "gaia2/dataset.h"
+#include "audiq/audiq_types.h"
+
+namespace audiq {
+namespace util {
+
+using gaia2::Point;
+using gaia2::DataSet;
+
+/**
+ * @brief DataSetUnion Read-only view of several datasets as one search space over their common descriptors.
+ * Points aren't copied and datasets aren't changed, so they must outlive the union.
+ * If several datasets contain point with the same name, the point of the first added dataset is used
+ * (the same rule as in SumDataSets).
+ */
+class DataSetUnion {
+ public:
+  DataSetUnion() {}
+  explicit DataSetUnion(const vector<DataSet*> &datasets);
+
+  void Add(const DataSet *dataset);
+  void Add(const DataSetUnion &other);
+
+  int Size() const { return static_cast<int>(_points.size()); }
+  const Point* At(int i) const { return _points[i]; }
+  bool Contains(const QString &point_name) const { return _names.contains(point_name); }
+  QStringList PointNames() const;
+  /**
+   * CommonDescriptors Intersection of datasets descriptors, in the order of the first dataset layout.
+   */
+  QStringList CommonDescriptors(const QStringList &patterns = QStringList() << "*") const;
+  const vector<const DataSet*>& DataSets() const { return _datasets; }
+
+ private:
+  vector<const DataSet*> _datasets;
+  vector<const Point*> _points;
+  QSet<QString> _names;
+};
+
+}  // namespace util
+}  // namespace audiq
+#endif  // PROJECT_AUDIQ_DATASET_UNION_H
@@ -0,0 +1,108 @@
+#include "audiq/audiq_duplicates.h"
+#include <cmath>
+#include <random>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <unordered_set>
+#include "audiq/audiq_native_metric.h"
+
+namespace audiq {
+namespace similarity {
+
+using std::vector;
+
+namespace {
+
+/**
+ * Root Returns root of 'i' in disjoint sets 'parents' compressing the path.
+ */
+int Root(vector<int> *parents, int i) {
+  while ( (*parents)[i] != i ) {
+    (*parents)[i] = (*parents)[(*parents)[i]];
+    i = (*parents)[i];
+  }
+  return i;
+}
+
+bool NearDuplicates(const FeatureStore &store, int i, int j) {
+  return PcaDistance(store.Pca().Row(i), store.Pca().Row(j)) <= DUPLICATE_PCA_DISTANCE
+         && MfccDistance(store, i, store, j) <= DUPLICATE_MFCC_DISTANCE;
+}
+
+}  // namespace
+
+int ClusterDuplicates(FeatureStore *store) {
+  const int size = store->Size();
+  const int dimension = store->Pca().Dimension();
+  vector<int> parents(size);
+  for ( int i = 0; i < size; ++i ) {
+    parents[i] = i;
+  }
+  std::mt19937 generator(0);
+  std::normal_distribution<float> normal(0.0, 1.0);
+  std::uniform_real_distribution<float> uniform(0.0, DUPLICATE_BUCKET_WIDTH);
+  vector<float> projections(DUPLICATE_HASHES * dimension);
+  vector<float> shifts(DUPLICATE_HASHES);
+  vector<std::pair<uint64_t, int> > buckets(size);
+  for ( int t = 0; t < DUPLICATE_TABLES; ++t ) {
+    for ( auto &p : projections ) {
+      p = normal(generator);
+    }
+    for ( auto &s : shifts ) {
+      s = uniform(generator);
+    }
+    for ( int i = 0; i < size; ++i ) {
+      const float* row = store->Pca().Row(i);
+      uint64_t key = 0;
+      for ( int h = 0; h < DUPLICATE_HASHES; ++h ) {
+        float value = shifts[h];
+        for ( int d = 0; d < dimension; ++d ) {
+          value += projections[h * dimension + d] * row[d];
+        }
+        key = key * 1000003 ^ static_cast<uint64_t>(static_cast<int64_t>(std::floor(value / DUPLICATE_BUCKET_WIDTH)));
+      }
+      buckets[i] = std::make_pair(key, i);
+    }
+    std::sort(buckets.begin(), buckets.end());
+    for ( int b = 0; b < size; ++b ) {
+      for ( int c = b + 1; c < std::min(size, b + 1 + DUPLICATE_CANDIDATES)
+                           && buckets[c].first == buckets[b].first; ++c ) {
+        int i = Root(&parents, buckets[b].second), j = Root(&parents, buckets[c].second);
+        if ( i != j && NearDuplicates(*store, buckets[b].second, buckets[c].second) ) {
+          // the first row of cluster is its root
+          parents[std::max(i, j)] = std::min(i, j);
+        }
+      }
+    }
+  }
+  vector<int> sizes(size, 0);
+  for ( int i = 0; i < size; ++i ) {
+    ++sizes[Root(&parents, i)];
+  }
+  int duplicates = 0;
+  for ( int i = 0; i < size; ++i ) {
+    int root = Root(&parents, i);
+    store->SetCluster(i, sizes[root] > 1 ? root : -1);
+    duplicates += root != i;
+  }
+  return duplicates;
+}
+
+vector<bool> DuplicateRows(const FeatureStore &store, const vector<bool> &exclude) {
+  vector<bool> duplicates;
+  std::unordered_set<int> clusters;
+  for ( int i = 0; i < store.Size(); ++i ) {
+    if ( store.Cluster(i) < 0 || (!exclude.empty() && exclude[i]) ) {
+      continue;
+    }
+    if ( !clusters.insert(store.Cluster(i)).second ) {
+      duplicates.resize(store.Size(), false);
+      duplicates[i] = true;
+    }
+  }
+  return duplicates;
+}
+
+}  // namespace similarity
+}  // namespace audiq
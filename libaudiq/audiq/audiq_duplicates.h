@@ -0,0 +1,38 @@
+#ifndef PROJECT_AUDIQ_DUPLICATES_H
+#define PROJECT_AUDIQ_DUPLICATES_H
+
+#include <vector>
+#include "audiq/audiq_feature_store.h"
+
+// points are near-duplicates if both their pca and mfcc distances don't exceed these ones
+#define DUPLICATE_PCA_DISTANCE  0.05f
+#define DUPLICATE_MFCC_DISTANCE 0.5f
+// locality-sensitive hashing of pca: DUPLICATE_TABLES tables with keys of DUPLICATE_HASHES projections,
+// quantized to buckets of DUPLICATE_BUCKET_WIDTH
+#define DUPLICATE_TABLES        12
+#define DUPLICATE_HASHES        6
+#define DUPLICATE_BUCKET_WIDTH  (4 * DUPLICATE_PCA_DISTANCE)
+// every point is compared with at most this number of the next points of its bucket
+#define DUPLICATE_CANDIDATES    16
+
+namespace audiq {
+namespace similarity {
+
+/**
+ * @brief ClusterDuplicates Finds near-duplicates of 'store' (renders with another bit depth, trimmed or normalized
+ * copies) and sets their clusters (FeatureStore::Cluster): the representative of cluster is its first row.
+ * Candidates are points which share a bucket of p-stable LSH of pca in any table, so time is near-linear.
+ * @return Number of points which aren't representatives.
+ */
+int ClusterDuplicates(FeatureStore *store);
+
+/**
+ * @brief DuplicateRows Marks rows of 'store' which are in the same cluster as some previous row not marked
+ * in 'exclude' (rows which are excluded from search anyway), so search excluding them returns one representative
+ * per cluster: the first row of cluster which may be recommended. Returns empty vector if there are no such rows.
+ */
+std::vector<bool> DuplicateRows(const FeatureStore &store, const std::vector<bool> &exclude = std::vector<bool>());
+
+}  // namespace similarity
+}  // namespace audiq
+#endif  // PROJECT_AUDIQ_DUPLICATES_H
@@ -0,0 +1,69 @@
+#include "audiq/audiq_engine.h"
+#include <utility>
+#include "audiq/audiq_util.h"
+
+namespace audiq {
+
+namespace {
+
+/**
+ * Submit Runs 'task' on 'pool', returns future of its result.
+ */
+template <typename T>
+std::future<T> Submit(util::ThreadPool *pool, std::function<T()> task) {
+  // pool tasks are copyable functions, so packaged task is shared
+  auto packaged = std::make_shared<std::packaged_task<T()> >(std::move(task));
+  std::future<T> result = packaged->get_future();
+  pool->Submit([packaged] { (*packaged)(); });
+  return result;
+}
+
+/**
+ * PoolRequest Returns 'request' searched on one thread: requests already run concurrently on threads of pool.
+ */
+RecommendRequest PoolRequest(const RecommendRequest &request) {
+  RecommendRequest single = request;
+  single.options.threads = 1;
+  return single;
+}
+
+}  // namespace
+
+Engine::Engine(std::shared_ptr<const similarity::Catalog> catalog, int threads)
+    : _catalog(std::move(catalog)), _pool(threads) {}
+
+std::shared_ptr<const similarity::Catalog> Engine::Load(const std::string &global_dataset_name,
+                                                        const similarity::SearchOptions &options) {
+  util::InitGaia();
+  std::shared_ptr<similarity::Catalog> catalog = std::make_shared<similarity::Catalog>();
+  if ( !catalog->Load(global_dataset_name, options) ) {
+    return nullptr;
+  }
+  return catalog;
+}
+
+std::future<types::audiq_neighbours> Engine::Neighbours(const RecommendRequest &original) {
+  std::shared_ptr<const similarity::Catalog> catalog = _catalog;
+  RecommendRequest request = PoolRequest(original);
+  return Submit<types::audiq_neighbours>(&_pool, [catalog, request] {
+    return catalog->Neighbours(request.one_dataset, request.user_dataset_name, request.weights, request.options);
+  });
+}
+
+std::future<types::audiq_similar> Engine::Recommend(const RecommendRequest &original) {
+  std::shared_ptr<const similarity::Catalog> catalog = _catalog;
+  RecommendRequest request = PoolRequest(original);
+  return Submit<types::audiq_similar>(&_pool, [catalog, request] {
+    return catalog->Recommend(request.one_dataset, request.user_dataset_name, request.weights, request.options);
+  });
+}
+
+std::future<void> Engine::Stream(const RecommendRequest &original, const similarity::RecommendationHandler &handler) {
+  std::shared_ptr<const similarity::Catalog> catalog = _catalog;
+  RecommendRequest request = PoolRequest(original);
+  return Submit<void>(&_pool, [catalog, request, handler] {
+    catalog->Stream(request.one_dataset, request.user_dataset_name, request.weights, request.options, handler);
+  });
+}
+
+}  // namespace audiq
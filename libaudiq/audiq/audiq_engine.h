@@ -0,0 +1,73 @@
+#ifndef PROJECT_AUDIQ_ENGINE_H
+#define PROJECT_AUDIQ_ENGINE_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <future>
+#include "audiq/audiq_types.h"
+#include "audiq/audiq_catalog.h"
+#include "audiq/audiq_concurrency.h"
+#include "audiq/audiq_search_options.h"
+#include "audiq/audiq_similarity_model.h"
+
+namespace audiq {
+
+/**
+ * @brief RecommendRequest Everything one recommendation depends on: user datasets
+ * 'user_dataset_name'_TYPE.db, dataset mode, metric weights and search options.
+ */
+struct RecommendRequest {
+  RecommendRequest() : one_dataset(false), weights({ 1.0, 1.0, 1.0 }) {}
+  std::string user_dataset_name;
+  bool one_dataset;
+  std::vector<float> weights;
+  similarity::SearchOptions options;
+};
+
+/**
+ * @brief Engine Reentrant recommendation engine: requests are searched concurrently on 'threads' threads against
+ * one loaded catalog, which isn't changed after Load, so search takes no locks. Every request is searched on one
+ * thread of engine ('options.threads' of requests is ignored). Every request builds its own
+ * queries and result, nothing of it is kept by engine. Catalog is shared: it's kept alive by running requests
+ * even if engine is destroyed before them, several engines may share it.
+ * Destructor waits for submitted requests.
+ */
+class Engine {
+ public:
+  explicit Engine(std::shared_ptr<const similarity::Catalog> catalog, int threads = 0);
+
+  Engine(const Engine&) = delete;
+  Engine& operator=(const Engine&) = delete;
+
+  /**
+   * Load Loads catalog of global datasets 'global_dataset_name', returns nullptr if there are no such datasets.
+   */
+  static std::shared_ptr<const similarity::Catalog> Load(const std::string &global_dataset_name,
+                                                         const similarity::SearchOptions &options);
+
+  /**
+   * Neighbours Submits 'request', future gets similar samples with their distances
+   * (or exception thrown by search).
+   */
+  std::future<types::audiq_neighbours> Neighbours(const RecommendRequest &request);
+  /**
+   * Recommend Same as Neighbours, but without distances.
+   */
+  std::future<types::audiq_similar> Recommend(const RecommendRequest &request);
+  /**
+   * Stream Submits 'request', similar samples of every user sample are passed to 'handler' as soon as they
+   * are found (see similarity::StreamSimilar), future is ready when all of them are passed.
+   * Handlers of different requests are called concurrently.
+   */
+  std::future<void> Stream(const RecommendRequest &request, const similarity::RecommendationHandler &handler);
+
+  const similarity::Catalog& Catalog() const { return *_catalog; }
+
+ private:
+  std::shared_ptr<const similarity::Catalog> _catalog;
+  util::ThreadPool _pool;
+};
+
+}  // namespace audiq
+#endif  // PROJECT_AUDIQ_ENGINE_H
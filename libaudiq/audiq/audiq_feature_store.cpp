@@ -0,0 +1,392 @@
+#include "audiq/audiq_feature_store.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <atomic>
+#include <fstream>
+#include <algorithm>
+#include "audiq/audiq_config.h"
+#include "audiq/audiq_binary_io.h"
+
+#define FEATURE_STORE_MAGIC   "AQFS"
+#define FEATURE_STORE_VERSION 4
+
+namespace audiq {
+namespace similarity {
+
+namespace {
+
+void CopyDescriptor(const Point *point, const QString &name, float *row, int dimension) {
+  gaia2::RealDescriptor value = point->value(name);
+  int n = std::min(static_cast<int>(value.size()), dimension);
+  for ( int i = 0; i < n; ++i ) {
+    row[i] = value[i];
+  }
+}
+
+/**
+ * SetMfccTerms Computes rows of FeatureStore mfcc terms blocks from gaussian 'mean', 'cov', 'icov'.
+ */
+void SetMfccTerms(const float *mean, const float *cov, const float *icov, float *icov_terms, float *cov_terms) {
+  const int n = MFCC_DIMENSION;
+  int k = 0;
+  for ( int r = 0; r < n; ++r ) {
+    for ( int c = r; c < n; ++c, ++k ) {
+      double scatter = static_cast<double>(cov[r * n + c]) + static_cast<double>(mean[r]) * mean[c];
+      icov_terms[k] = icov[r * n + c];
+      cov_terms[k] = (r == c ? 1.0 : 2.0) * scatter;
+    }
+  }
+  double norm = 0.0;
+  for ( int r = 0; r < n; ++r ) {
+    double product = 0.0;
+    for ( int c = 0; c < n; ++c ) {
+      product += static_cast<double>(icov[r * n + c]) * mean[c];
+    }
+    icov_terms[k + r] = mean[r];
+    cov_terms[k + r] = -2.0 * product;
+    norm += mean[r] * product;
+  }
+  icov_terms[k + n] = 1.0;
+  cov_terms[k + n] = norm;
+}
+
+/**
+ * LabelName Short name of label descriptor: "key", "scale" or name of highlevel classifier.
+ */
+std::string LabelName(const std::string &descriptor) {
+  if ( descriptor.compare(0, 6, "tonal.") == 0 ) {
+    return descriptor.substr(descriptor.rfind('.') + 1);
+  }
+  size_t begin = descriptor.find('.') + 1;
+  return descriptor.substr(begin, descriptor.find('.', begin) - begin);
+}
+
+bool ReadStoreHeader(std::istream &in, int *size, QStringList *highlevel_names) {
+  int32_t highlevel_size;
+  // every highlevel name takes at least its size
+  if ( !util::ReadHeader(in, FEATURE_STORE_MAGIC, FEATURE_STORE_VERSION)
+       || !util::ReadValue(in, size) || !util::ReadValue(in, &highlevel_size) || *size < 0 || highlevel_size < 0
+       || !util::FitsStream(in, static_cast<uint64_t>(highlevel_size) * sizeof(uint32_t)) ) {
+    return false;
+  }
+  highlevel_names->clear();
+  std::string name;
+  for ( int d = 0; d < highlevel_size; ++d ) {
+    if ( !util::ReadString(in, &name) ) {
+      return false;
+    }
+    *highlevel_names << QString::fromStdString(name);
+  }
+  // descriptor blocks follow the header, so corrupt size is rejected before store is allocated
+  const uint64_t row_values = AlignedBlock<float>::PaddedDimension(PCA_DIMENSION)
+                              + 2 * AlignedBlock<float>::PaddedDimension(MFCC_TERMS)
+                              + AlignedBlock<float>::PaddedDimension(highlevel_size);
+  return util::FitsStream(in, static_cast<uint64_t>(*size) * row_values * sizeof(float));
+}
+
+}  // namespace
+
+FeatureStore::FeatureStore(int size, const QStringList &highlevel_names)
+    : _size(size),
+      _highlevel_names(highlevel_names),
+      _pca(size, PCA_DIMENSION),
+      _mfcc_icov_terms(size, MFCC_TERMS),
+      _mfcc_cov_terms(size, MFCC_TERMS),
+      _highlevel(size, highlevel_names.size()),
+      _file_names(size),
+      _point_names(size),
+      _durations(size, 0.0),
+      _clusters(size, -1) {
+  _index.reserve(size);
+}
+
+void FeatureStore::SetPoint(int i, const Point *point) {
+  CopyDescriptor(point, PCA_DESCRIPTOR, _pca.Row(i), _pca.Dimension());
+  SetDescriptors(i, point);
+}
+
+void FeatureStore::SetPoint(int i, const Point *point, const float *pca) {
+  std::copy(pca, pca + _pca.Dimension(), _pca.Row(i));
+  SetDescriptors(i, point);
+}
+
+void FeatureStore::CopyRow(int i, const FeatureStore &other, int j) {
+  std::copy(other._pca.Row(j), other._pca.Row(j) + _pca.Stride(), _pca.Row(i));
+  std::copy(other._mfcc_icov_terms.Row(j), other._mfcc_icov_terms.Row(j) + _mfcc_icov_terms.Stride(),
+            _mfcc_icov_terms.Row(i));
+  std::copy(other._mfcc_cov_terms.Row(j), other._mfcc_cov_terms.Row(j) + _mfcc_cov_terms.Stride(),
+            _mfcc_cov_terms.Row(i));
+  std::copy(other._highlevel.Row(j), other._highlevel.Row(j) + _highlevel.Stride(), _highlevel.Row(i));
+  _durations[i] = other._durations[j];
+  _clusters[i] = other._clusters[j];
+  for ( size_t c = 0; c < other._label_names.size(); ++c ) {
+    SetLabel(i, other._label_names[c], other.Label(j, c));
+  }
+  _file_names[i] = other._file_names[j];
+  _point_names[i] = other._point_names[j];
+  _index.insert(_point_names[i], i);
+}
+
+void FeatureStore::SetDescriptors(int i, const Point *point) {
+  float mean[MFCC_DIMENSION] = {};
+  float cov[MFCC_DIMENSION * MFCC_DIMENSION] = {};
+  float icov[MFCC_DIMENSION * MFCC_DIMENSION] = {};
+  CopyDescriptor(point, MFCC_MEAN, mean, MFCC_DIMENSION);
+  CopyDescriptor(point, MFCC_COV, cov, MFCC_DIMENSION * MFCC_DIMENSION);
+  CopyDescriptor(point, MFCC_ICOV, icov, MFCC_DIMENSION * MFCC_DIMENSION);
+  SetMfccTerms(mean, cov, icov, _mfcc_icov_terms.Row(i), _mfcc_cov_terms.Row(i));
+  float* highlevel = _highlevel.Row(i);
+  for ( int d = 0; d < _highlevel_names.size(); ++d ) {
+    CopyDescriptor(point, _highlevel_names.at(d), highlevel + d, 1);
+  }
+  _file_names[i] = point->label(FILENAME_DESCRIPTOR).toSingleValue().toStdString();
+  _point_names[i] = point->name();
+  _index.insert(point->name(), i);
+  SetMetadata(i, point);
+}
+
+void FeatureStore::SetMetadata(int i, const Point *point) {
+  _durations[i] = PointDuration(point);
+  QStringList patterns = QStringList() << KEY_DESCRIPTORS << SCALE_DESCRIPTORS << CLASS_DESCRIPTORS;
+  // labels are enumerated in prepared datasets and strings in loaded points
+  QStringList names = point->layout().descriptorNames(gaia2::EnumType, patterns, QStringList(), false);
+  names << point->layout().descriptorNames(gaia2::StringType, patterns, QStringList(), false);
+  for ( const auto &name : names ) {
+    std::string label = LabelName(name.toStdString());
+    int column = LabelColumn(label);
+    // the first of several key estimations is kept
+    if ( column < 0 || _label_codes[column][i] == 0 ) {
+      SetLabel(i, label, point->label(name).toSingleValue().toStdString());
+    }
+  }
+}
+
+int FeatureStore::LabelColumn(const std::string &name) const {
+  auto found = std::find(_label_names.begin(), _label_names.end(), name);
+  return found == _label_names.end() ? -1 : static_cast<int>(found - _label_names.begin());
+}
+
+const std::string& FeatureStore::Label(int i, int column) const {
+  static const std::string none;
+  int code = _label_codes[column][i];
+  return code == 0 ? none : _label_values[column][code - 1];
+}
+
+void FeatureStore::SetLabel(int i, const std::string &name, const std::string &value) {
+  int column = LabelColumn(name);
+  if ( column < 0 ) {
+    column = _label_names.size();
+    _label_names.push_back(name);
+    _label_values.push_back(vector<string>());
+    _label_codes.push_back(vector<uint32_t>(_size, 0));
+    _label_lookup.push_back(std::unordered_map<string, uint32_t>());
+  }
+  if ( value.empty() ) {
+    _label_codes[column][i] = 0;
+    return;
+  }
+  auto found = _label_lookup[column].find(value);
+  if ( found == _label_lookup[column].end() ) {
+    _label_values[column].push_back(value);
+    found = _label_lookup[column].insert(std::make_pair(value, _label_values[column].size())).first;
+  }
+  _label_codes[column][i] = found->second;
+}
+
+bool FeatureStore::PageDescriptors() {
+  if ( _paged ) {
+    return true;
+  }
+  AlignedBlock<float>* blocks[] = { &_pca, &_mfcc_icov_terms, &_mfcc_cov_terms, &_highlevel };
+  size_t bytes = 0;
+  for ( auto block : blocks ) {
+    bytes += block->Bytes();
+  }
+  if ( bytes == 0 ) {
+    return true;
+  }
+  static std::atomic<unsigned> files(0);
+  std::string file_name = (filesystem::temp_directory_path()
+                           / ("audiq_rows_" + std::to_string(getpid()) + "_" + std::to_string(files++))).string();
+  std::ofstream out(file_name, std::ios::binary);
+  for ( auto block : blocks ) {
+    out.write(reinterpret_cast<const char*>(block->Data()), block->Bytes());
+  }
+  out.close();
+  int file = out ? open(file_name.c_str(), O_RDONLY) : -1;
+  void* mapping = file >= 0 ? mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, file, 0) : MAP_FAILED;
+  if ( file >= 0 ) {
+    close(file);
+  }
+  filesystem::remove(file_name);
+  if ( mapping == MAP_FAILED ) {
+    return false;
+  }
+  // rerank reads rows in random order, so pages aren't read ahead
+  madvise(mapping, bytes, MADV_RANDOM);
+  _paged = std::shared_ptr<void>(mapping, [bytes](void *m) { munmap(m, bytes); });
+  // blocks are padded to BLOCK_ALIGNMENT bytes, so every block of page aligned mapping is aligned too
+  const char* data = static_cast<const char*>(mapping);
+  for ( auto block : blocks ) {
+    const size_t block_bytes = block->Bytes();
+    block->View(reinterpret_cast<const float*>(data), block->Rows(), block->Dimension());
+    data += block_bytes;
+  }
+  return true;
+}
+
+void FeatureStore::ShareDescriptors(const FeatureStore &other, int first_row) {
+  _pca.View(other._pca.Row(first_row), _size, _pca.Dimension());
+  _mfcc_icov_terms.View(other._mfcc_icov_terms.Row(first_row), _size, _mfcc_icov_terms.Dimension());
+  _mfcc_cov_terms.View(other._mfcc_cov_terms.Row(first_row), _size, _mfcc_cov_terms.Dimension());
+  _highlevel.View(other._highlevel.Row(first_row), _size, _highlevel.Dimension());
+  _paged = other._paged;
+}
+
+size_t FeatureStore::Bytes() const {
+  size_t blocks = _pca.Bytes() + _mfcc_icov_terms.Bytes() + _mfcc_cov_terms.Bytes() + _highlevel.Bytes();
+  // paged blocks are in mapped file, shared ones are counted by their owner
+  return (_paged || !_pca.Owned() ? 0 : blocks) + _durations.size() * sizeof(float)
+         + _label_codes.size() * _size * sizeof(uint32_t) + _clusters.size() * sizeof(int);
+}
+
+float PointDuration(const Point *point) {
+  if ( point->layout().descriptorNames(gaia2::RealType, QStringList() << DURATION_DESCRIPTOR,
+                                       QStringList(), false).empty() ) {
+    return 0.0;
+  }
+  gaia2::RealDescriptor value = point->value(DURATION_DESCRIPTOR);
+  return value.empty() ? 0.0 : value[0];
+}
+
+QStringList HighlevelDescriptors(const DataSet *dataset) {
+  return dataset->layout().descriptorNames(gaia2::RealType,
+                                           QStringList() << HIGHLEVEL_PROBABILITIES);
+}
+
+QStringList HighlevelDescriptors(const util::DataSetUnion &points) {
+  return points.CommonDescriptors(QStringList() << HIGHLEVEL_PROBABILITIES);
+}
+
+FeatureStore* BuildFeatureStore(const DataSet *dataset) {
+  return BuildFeatureStore(dataset, HighlevelDescriptors(dataset));
+}
+
+FeatureStore* BuildFeatureStore(const DataSet *dataset, const QStringList &highlevel_names) {
+  FeatureStore* store = new FeatureStore(dataset->size(), highlevel_names);
+  for ( int i = 0; i < dataset->size(); ++i ) {
+    store->SetPoint(i, dataset->at(i));
+  }
+  return store;
+}
+
+FeatureStore* BuildFeatureStore(const util::DataSetUnion &points, const QStringList &highlevel_names) {
+  FeatureStore* store = new FeatureStore(points.Size(), highlevel_names);
+  for ( int i = 0; i < points.Size(); ++i ) {
+    store->SetPoint(i, points.At(i));
+  }
+  return store;
+}
+
+FeatureStore* ConcatenateFeatureStores(const std::vector<const FeatureStore*> &stores) {
+  int size = 0;
+  for ( auto s : stores ) {
+    size += s->Size();
+  }
+  FeatureStore* result = new FeatureStore(size, stores.empty() ? QStringList() : stores[0]->HighlevelNames());
+  int row = 0;
+  for ( auto s : stores ) {
+    const int offset = row;
+    for ( int j = 0; j < s->Size(); ++j ) {
+      result->CopyRow(row, *s, j);
+      // clusters are rows of representatives
+      if ( s->Cluster(j) >= 0 ) {
+        result->SetCluster(row, s->Cluster(j) + offset);
+      }
+      ++row;
+    }
+  }
+  return result;
+}
+
+bool SaveFeatureStore(const FeatureStore &store, const std::string &file_name) {
+  std::ofstream out(file_name, std::ios::binary);
+  util::WriteHeader(out, FEATURE_STORE_MAGIC, FEATURE_STORE_VERSION);
+  util::WriteValue<int32_t>(out, store._size);
+  util::WriteValue<int32_t>(out, store._highlevel_names.size());
+  for ( auto name : store._highlevel_names ) {
+    util::WriteString(out, name.toStdString());
+  }
+  for ( auto block : { &store._pca, &store._mfcc_icov_terms, &store._mfcc_cov_terms, &store._highlevel } ) {
+    util::WriteArray(out, block->Data(), block->Bytes() / sizeof(float));
+  }
+  for ( int i = 0; i < store._size; ++i ) {
+    util::WriteString(out, store._file_names[i]);
+    util::WriteString(out, store._point_names[i].toStdString());
+  }
+  util::WriteVector(out, store._durations);
+  util::WriteValue<int32_t>(out, store._label_names.size());
+  for ( size_t c = 0; c < store._label_names.size(); ++c ) {
+    util::WriteString(out, store._label_names[c]);
+    util::WriteValue<int32_t>(out, store._label_values[c].size());
+    for ( const auto &value : store._label_values[c] ) {
+      util::WriteString(out, value);
+    }
+    util::WriteVector(out, store._label_codes[c]);
+  }
+  return static_cast<bool>(out);
+}
+
+bool ReadFeatureStoreHeader(const std::string &file_name, int *size, QStringList *highlevel_names) {
+  std::ifstream in(file_name, std::ios::binary);
+  return ReadStoreHeader(in, size, highlevel_names);
+}
+
+FeatureStore* LoadFeatureStore(const std::string &file_name) {
+  std::ifstream in(file_name, std::ios::binary);
+  int size;
+  QStringList highlevel_names;
+  std::string name;
+  if ( !ReadStoreHeader(in, &size, &highlevel_names) ) {
+    return nullptr;
+  }
+  FeatureStore* store = new FeatureStore(size, highlevel_names);
+  bool ok = true;
+  for ( auto block : { &store->_pca, &store->_mfcc_icov_terms, &store->_mfcc_cov_terms, &store->_highlevel } ) {
+    ok = ok && util::ReadArray(in, block->Data(), block->Bytes() / sizeof(float));
+  }
+  for ( int i = 0; ok && i < size; ++i ) {
+    ok = util::ReadString(in, &store->_file_names[i]) && util::ReadString(in, &name);
+    store->_point_names[i] = QString::fromStdString(name);
+    store->_index.insert(store->_point_names[i], i);
+  }
+  int32_t labels = 0, values = 0;
+  ok = ok && util::ReadVector(in, &store->_durations) && store->_durations.size() == static_cast<size_t>(size)
+       && util::ReadValue(in, &labels);
+  for ( int c = 0; ok && c < labels; ++c ) {
+    store->_label_names.push_back(string());
+    store->_label_values.push_back(vector<string>());
+    store->_label_codes.push_back(vector<uint32_t>());
+    store->_label_lookup.push_back(std::unordered_map<string, uint32_t>());
+    ok = util::ReadString(in, &store->_label_names[c]) && util::ReadValue(in, &values);
+    for ( int v = 0; ok && v < values; ++v ) {
+      ok = util::ReadString(in, &name);
+      store->_label_values[c].push_back(name);
+      store->_label_lookup[c][name] = v + 1;
+    }
+    ok = ok && util::ReadVector(in, &store->_label_codes[c])
+         && store->_label_codes[c].size() == static_cast<size_t>(size);
+    for ( int i = 0; ok && i < size; ++i ) {
+      ok = store->_label_codes[c][i] <= store->_label_values[c].size();
+    }
+  }
+  if ( !ok ) {
+    delete store;
+    return nullptr;
+  }
+  return store;
+}
+
+}  // namespace similarity
+}  // namespace audiq
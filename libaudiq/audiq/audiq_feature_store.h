@@ -0,0 +1,190 @@
+#ifndef PROJECT_AUDIQ_FEATURE_STORE_H
+#define PROJECT_AUDIQ_FEATURE_STORE_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include "gaia2/point.h"
+#include "gaia2/dataset.h"
+#include "audiq/audiq_types.h"
+#include "audiq/audiq_config.h"
+#include "audiq/audiq_aligned_block.h"
+#include "audiq/audiq_dataset_union.h"
+
+namespace audiq {
+namespace similarity {
+
+using gaia2::Point;
+using gaia2::DataSet;
+
+/**
+ * @brief FeatureStore Contiguous structure-of-arrays copy of the descriptors used by audiq metrics.
+ * Point 'i' of the store is row 'i' of every block:
+ *  - pca              N x PCA_DIMENSION values of "pca" descriptor;
+ *  - mfcc_icov_terms  N x MFCC_TERMS [ packed(I), m, 1 ];
+ *  - mfcc_cov_terms   N x MFCC_TERMS [ packed2(C + m * m'), -2 * I * m, m' * I * m ];
+ *  - highlevel        N x H probabilities, where H is the size of 'HighlevelNames()'.
+ * Here m, C, I are "lowlevel.mfcc" mean, covariance and inverse covariance, packed() is the upper triangle
+ * of symmetric matrix and packed2() is the same with doubled off-diagonal values. Then the sum of traces and
+ * mahalanobis term of symmetric Kullback-Leibler distance between gaussians 'a' and 'b' is
+ * dot(icov_terms[b], cov_terms[a]) + dot(icov_terms[a], cov_terms[b]) (log-determinants cancel out).
+ * Besides descriptors store keeps metadata used by search filters: duration and labels of every point.
+ * Labels are columns named "key", "scale" and by highlevel classifiers ("bass", "shot_or_loop", ...),
+ * their values are interned per column. Near-duplicate cluster of every point (see ClusterDuplicates) is kept
+ * in memory only, it isn't saved with the store.
+ */
+class FeatureStore {
+ public:
+  FeatureStore(int size, const QStringList &highlevel_names);
+
+  /**
+   * SetPoint Copies descriptors of 'point' to row 'i'.
+   */
+  void SetPoint(int i, const Point *point);
+  /**
+   * SetPoint Copies descriptors of 'point' to row 'i', but pca values are taken from 'pca'
+   * (for points which are projected by audiq itself).
+   */
+  void SetPoint(int i, const Point *point, const float *pca);
+  /**
+   * CopyRow Copies row 'j' of 'other' store to row 'i'. Stores must have the same 'HighlevelNames()'.
+   */
+  void CopyRow(int i, const FeatureStore &other, int j);
+
+  int Size() const { return _size; }
+  const QStringList& HighlevelNames() const { return _highlevel_names; }
+
+  const AlignedBlock<float>& Pca() const { return _pca; }
+  const AlignedBlock<float>& MfccIcovTerms() const { return _mfcc_icov_terms; }
+  const AlignedBlock<float>& MfccCovTerms() const { return _mfcc_cov_terms; }
+  const AlignedBlock<float>& Highlevel() const { return _highlevel; }
+
+  const std::string& FileName(int i) const { return _file_names[i]; }
+  const QString& PointName(int i) const { return _point_names[i]; }
+  /**
+   * IndexOf Returns row of point with name 'point_name' or -1 if store doesn't contain it.
+   */
+  int IndexOf(const QString &point_name) const { return _index.value(point_name, -1); }
+
+  /**
+   * Duration Duration of point 'i' in seconds, 0 if unknown.
+   */
+  float Duration(int i) const { return _durations[i]; }
+  void SetDuration(int i, float duration) { _durations[i] = duration; }
+  const std::vector<std::string>& LabelNames() const { return _label_names; }
+  /**
+   * LabelColumn Returns column of label 'name' or -1 if points have no such label.
+   */
+  int LabelColumn(const std::string &name) const;
+  /**
+   * Label Value of label 'column' of point 'i', empty if point has no value.
+   */
+  const std::string& Label(int i, int column) const;
+  void SetLabel(int i, const std::string &name, const std::string &value);
+  /**
+   * Cluster Near-duplicate cluster of point 'i' (row of its representative in the clustered store),
+   * -1 if point has no duplicates.
+   */
+  int Cluster(int i) const { return _clusters[i]; }
+  void SetCluster(int i, int cluster) { _clusters[i] = cluster; }
+
+  /**
+   * PageDescriptors Moves descriptor blocks to a temporary file mapped to memory: rows are read from the file
+   * when searches use them and system may drop them from memory again, so a store which is only reranked
+   * (searched through quantized copy or index) doesn't keep all rows resident. File is removed at once,
+   * mapping keeps it until store is deleted. Descriptors of paged store can't be changed.
+   * Returns false (and keeps blocks in memory) on failure.
+   */
+  bool PageDescriptors();
+  bool Paged() const { return static_cast<bool>(_paged); }
+  /**
+   * ShareDescriptors Replaces descriptor blocks by views of rows of 'other' starting at 'first_row':
+   * 'other' must have the same points in the same order from this row (e.g. it's a concatenation of stores,
+   * see ConcatenateFeatureStores) and the same 'HighlevelNames()'. If 'other' is paged, its mapping is shared,
+   * otherwise 'other' must outlive this store. Descriptors of store can't be changed then.
+   */
+  void ShareDescriptors(const FeatureStore &other, int first_row);
+
+  /**
+   * Bytes Memory used by descriptor blocks (which aren't paged or shared) and metadata.
+   */
+  size_t Bytes() const;
+
+ private:
+  friend bool SaveFeatureStore(const FeatureStore &store, const std::string &file_name);
+  friend FeatureStore* LoadFeatureStore(const std::string &file_name);
+  void SetDescriptors(int i, const Point *point);
+  void SetMetadata(int i, const Point *point);
+
+  int _size;
+  QStringList _highlevel_names;
+  AlignedBlock<float> _pca;
+  AlignedBlock<float> _mfcc_icov_terms;
+  AlignedBlock<float> _mfcc_cov_terms;
+  AlignedBlock<float> _highlevel;
+  std::vector<std::string> _file_names;
+  std::vector<QString> _point_names;
+  QHash<QString, int> _index;
+  std::vector<float> _durations;
+  std::vector<std::string> _label_names;
+  // _label_values[c] - values of label column 'c', _label_codes[c][i] - value of point 'i' + 1 (0 - no value),
+  // _label_lookup[c] - codes of values of column 'c'
+  std::vector<std::vector<std::string> > _label_values;
+  std::vector<std::vector<uint32_t> > _label_codes;
+  std::vector<std::unordered_map<std::string, uint32_t> > _label_lookup;
+  std::vector<int> _clusters;
+  // mapping of paged (or shared paged) descriptor blocks
+  std::shared_ptr<void> _paged;
+};
+
+/**
+ * @brief PointDuration Duration of 'point' (DURATION_DESCRIPTOR) in seconds, 0 if point has no duration.
+ */
+float PointDuration(const Point *point);
+
+/**
+ * @brief HighlevelDescriptors Names of highlevel probabilities used by audiq metric, in layout order.
+ */
+QStringList HighlevelDescriptors(const DataSet *dataset);
+
+QStringList HighlevelDescriptors(const util::DataSetUnion &points);
+
+/**
+ * @brief BuildFeatureStore Builds feature store from prepared 'dataset' (result of util::PrepareDataSet).
+ * @param highlevel_names Highlevel probabilities to store, by default - all of 'dataset'.
+ * @note Store is an independent copy, 'dataset' can be deleted after this call.
+ */
+FeatureStore* BuildFeatureStore(const DataSet *dataset);
+
+FeatureStore* BuildFeatureStore(const DataSet *dataset, const QStringList &highlevel_names);
+/**
+ * @brief BuildFeatureStore Builds feature store from all points of 'points' union.
+ */
+FeatureStore* BuildFeatureStore(const util::DataSetUnion &points, const QStringList &highlevel_names);
+
+/**
+ * @brief SaveFeatureStore Saves 'store' to binary file 'file_name', returns false on failure.
+ */
+bool SaveFeatureStore(const FeatureStore &store, const std::string &file_name);
+/**
+ * @brief LoadFeatureStore Loads store saved with SaveFeatureStore, returns nullptr on failure.
+ */
+FeatureStore* LoadFeatureStore(const std::string &file_name);
+/**
+ * @brief ReadFeatureStoreHeader Reads number of rows and highlevel names of store saved with SaveFeatureStore
+ * without loading it, returns false on failure.
+ */
+bool ReadFeatureStoreHeader(const std::string &file_name, int *size, QStringList *highlevel_names);
+/**
+ * @brief ConcatenateFeatureStores Creates one store with rows of all 'stores' (they must have the same highlevel names).
+ */
+FeatureStore* ConcatenateFeatureStores(const std::vector<const FeatureStore*> &stores);
+
+}  // namespace similarity
+}  // namespace audiq
+#endif  // PROJECT_AUDIQ_FEATURE_STORE_H
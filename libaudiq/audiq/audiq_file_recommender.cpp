@@ -0,0 +1,221 @@
+#include "audiq/audiq_file_recommender.h"
+#include <unistd.h>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <exception>
+#include <utility>
+#include <iostream>
+#include <algorithm>
+#include "gaia2/gaia.h"
+#include "audiq/audiq_util.h"
+#include "audiq/audiq_processing.h"
+#include "audiq/audiq_hnsw_index.h"
+#include "audiq/audiq_duplicates.h"
+#include "audiq/audiq_similarity_model.h"
+#include "audiq/audiq_concurrency.h"
+
+namespace audiq {
+
+FileRecommender::FileRecommender(const std::string &profile, const std::string &models_directory)
+    : _profile(profile), _models_directory(models_directory) {}
+
+FileRecommender::~FileRecommender() {
+  Clear();
+}
+
+void FileRecommender::Clear() {
+  for ( auto &pair : _types ) {
+    delete pair.second.index;
+    delete pair.second.store;
+  }
+  _types.clear();
+}
+
+bool FileRecommender::Load(const std::string &global_dataset_name, const similarity::SearchOptions &options) {
+  util::InitGaia();
+  Clear();
+  for ( auto t : types::TYPES ) {
+    string name = global_dataset_name + "_" + t;
+    if ( !filesystem::exists(name + ".history") ) {
+      continue;
+    }
+    Part part;
+    part.store = util::LoadSegmentedDataSet(name);
+    if ( !part.store || !part.projection.Load(name + ".pca") ) {
+      std::cout << "Can't load dataset " << name << std::endl;
+      delete part.store;
+      continue;
+    }
+    part.history.load(QString::fromStdString(name + ".history"));
+    if ( options.collapse_duplicates ) {
+      similarity::ClusterDuplicates(part.store);
+    }
+    if ( options.index ) {
+      part.index = new similarity::HnswIndex;
+      part.index->Build(*part.store);
+    }
+    _types[t] = part;
+  }
+  if ( !_types.empty() && !_extractor ) {
+    _extractor = std::make_shared<processing::Extractor>(_profile, _models_directory);
+  }
+  return !_types.empty();
+}
+
+audiq_similar FileRecommender::RecommendForFile(const std::string &file_name, const std::vector<float> &weights,
+                                                const similarity::SearchOptions &options) const {
+  audiq_similar similar;
+  const Part* part = nullptr;
+  similarity::FeatureStore* queries = Query(file_name, &part);
+  if ( !queries ) {
+    return similar;
+  }
+  audiq_similar found_similar = similarity::FindSimilar(*part->store, *queries, nullptr, Indexes(*part, options),
+                                                        weights, options);
+  delete queries;
+  // result is keyed by the file of request, not by extracted file name tag
+  if ( !found_similar.empty() ) {
+    similar[file_name] = found_similar.begin()->second;
+  }
+  return similar;
+}
+
+int FileRecommender::StreamSamples(const std::string &samples_directory, const std::vector<float> &weights,
+                                   const similarity::SearchOptions &options,
+                                   const similarity::RecommendationHandler &handler) const {
+  // extraction isn't reentrant, so it's the one stage of pipeline, searches of extracted samples overlap it
+  util::BlockingQueue<std::pair<std::string, gaia2::Point*> > extracted(PIPELINE_QUEUE);
+  std::atomic<int> recommended(0);
+  // every sample is a separate search, they are parallel among themselves
+  similarity::SearchOptions query_options = options;
+  query_options.threads = 1;
+  query_options.report_recall = false;
+  // the first exception of extraction or searches, it's rethrown when all workers are joined
+  std::exception_ptr error;
+  std::mutex error_mutex;
+  std::atomic<bool> failed(false);
+  auto set_error = [&](std::exception_ptr e) {
+    std::lock_guard<std::mutex> lock(error_mutex);
+    if ( !error )
+      error = e;
+    // extraction stops, samples left in queue are dropped
+    failed = true;
+    extracted.Close();
+  };
+  auto worker = [&]() {
+    std::pair<std::string, gaia2::Point*> sample;
+    while ( extracted.Pop(&sample) ) {
+      std::unique_ptr<gaia2::Point> point(sample.second);
+      if ( failed ) {
+        continue;
+      }
+      try {
+        const Part* part = nullptr;
+        std::unique_ptr<similarity::FeatureStore> queries(Project(point.get(), sample.first, &part));
+        point.reset();
+        if ( !queries ) {
+          continue;
+        }
+        similarity::StreamSimilar(*part->store, *queries, nullptr, Indexes(*part, options), weights, query_options,
+                                  [&](const std::string&, const vector<similarity::Recommendation> &similar) {
+          handler(sample.first, similar);
+        });
+        ++recommended;
+      }
+      catch ( ... ) {
+        set_error(std::current_exception());
+      }
+    }
+  };
+  vector<std::thread> workers;
+  for ( int t = 0; t < std::max(1, util::ThreadsNumber(options.threads) - 1); ++t ) {
+    workers.emplace_back(worker);
+  }
+  // workers are joined even if extraction fails
+  try {
+    for ( const auto &file_name : processing::AudioFiles(samples_directory) ) {
+      gaia2::Point* point = ExtractPoint(file_name);
+      if ( point && !extracted.Push(std::make_pair(file_name, point)) ) {
+        // queue is closed by failed search
+        delete point;
+        break;
+      }
+    }
+  }
+  catch ( ... ) {
+    set_error(std::current_exception());
+  }
+  extracted.Close();
+  for ( auto &w : workers ) {
+    w.join();
+  }
+  if ( error ) {
+    std::rethrow_exception(error);
+  }
+  return recommended;
+}
+
+gaia2::Point* FileRecommender::ExtractPoint(const std::string &file_name) const {
+  processing::Pool pool;
+  if ( !_extractor || !_extractor->Extract(&pool, file_name) ) {
+    return nullptr;
+  }
+  // gaia2 reads points from yaml only, extractions may run concurrently, so every one has its own file
+  static std::atomic<unsigned> queries(0);
+  string sig = (filesystem::temp_directory_path()
+                / ("audiq_query_" + std::to_string(getpid()) + "_" + std::to_string(queries++) + ".sig")).string();
+  processing::SavePool(pool, sig);
+  gaia2::Point* point = util::LoadPoint(sig, filesystem::path(file_name).stem().string());
+  filesystem::remove(sig);
+  return point;
+}
+
+similarity::FeatureStore* FileRecommender::Project(const gaia2::Point *point, const std::string &file_name,
+                                                   const Part **part) const {
+  string type = point->label(TYPE_DESCRIPTOR).toSingleValue().toStdString();
+  auto found = _types.find(type);
+  if ( found == _types.end() ) {
+    std::cout << "There is no global dataset of type " << type << std::endl;
+    return nullptr;
+  }
+  *part = &found->second;
+  gaia2::Point* mapped = nullptr;
+  try {
+    mapped = (*part)->history.mapPoint(point);
+  }
+  catch ( std::exception &e ) {
+    std::cout << file_name << ": " << e.what() << std::endl;
+  }
+  float pca[PCA_DIMENSION] = { 0 };
+  if ( !mapped || !(*part)->projection.Project(mapped, pca) ) {
+    delete mapped;
+    return nullptr;
+  }
+  similarity::FeatureStore* queries = new similarity::FeatureStore(1, (*part)->store->HighlevelNames());
+  queries->SetPoint(0, mapped, pca);
+  delete mapped;
+  return queries;
+}
+
+similarity::FeatureStore* FileRecommender::Query(const std::string &file_name, const Part **part) const {
+  gaia2::Point* point = ExtractPoint(file_name);
+  if ( !point ) {
+    return nullptr;
+  }
+  similarity::FeatureStore* queries = Project(point, file_name, part);
+  delete point;
+  return queries;
+}
+
+std::vector<const similarity::HnswIndex*> FileRecommender::Indexes(const Part &part,
+                                                                   const similarity::SearchOptions &options) const {
+  vector<const similarity::HnswIndex*> indexes;
+  if ( options.index && part.index ) {
+    indexes.push_back(part.index);
+  }
+  return indexes;
+}
+
+}  // namespace audiq
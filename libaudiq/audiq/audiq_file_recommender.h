@@ -0,0 +1,99 @@
+#ifndef PROJECT_AUDIQ_FILE_RECOMMENDER_H
+#define PROJECT_AUDIQ_FILE_RECOMMENDER_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "gaia2/transformation.h"
+#include "audiq/audiq.h"
+#include "audiq/audiq_types.h"
+#include "audiq/audiq_config.h"
+#include "audiq/audiq_processing.h"
+#include "audiq/audiq_search_options.h"
+#include "audiq/audiq_feature_store.h"
+#include "audiq/audiq_similarity_model.h"
+#include "audiq/audiq_streaming_build.h"
+
+// maximum number of extracted samples waiting for search in StreamSamples
+#define PIPELINE_QUEUE 64
+
+namespace audiq {
+
+namespace similarity {
+class HnswIndex;
+}  // namespace similarity
+
+/**
+ * @brief FileRecommender Recommends for single audio files without creating user datasets.
+ * Global datasets must be built by util::StreamingBuildDataSets: their stored normalization history
+ * and PCA projection map extracted sample to the space of global dataset of its type.
+ */
+class FileRecommender {
+ public:
+  FileRecommender(const std::string &profile = "", const std::string &models_directory = MODELS_DIR);
+  ~FileRecommender();
+
+  FileRecommender(const FileRecommender&) = delete;
+  FileRecommender& operator=(const FileRecommender&) = delete;
+
+  /**
+   * Load Loads global datasets 'global_dataset_name'_TYPE (segments, .history and .pca),
+   * HNSW index of each type is built if 'options.index' is set. Returns false if there are no such datasets.
+   * Extractor and classifiers are loaded here too, once, and reused by all requests.
+   */
+  bool Load(const std::string &global_dataset_name, const similarity::SearchOptions &options);
+  /**
+   * RecommendForFile Extracts descriptors of 'file_name', projects them, classifies sample type and
+   * searches similar samples in global dataset of this type.
+   * @return result with one key 'file_name', empty if sample can't be extracted or there is no dataset of its type.
+   */
+  audiq_similar RecommendForFile(const std::string &file_name, const std::vector<float> &weights,
+                                 const similarity::SearchOptions &options) const;
+  /**
+   * StreamSamples Recommends for all audio files of 'samples_directory' in pipeline: files are extracted one by one,
+   * while already extracted samples are projected and searched on 'options.threads' threads (one of them extracts).
+   * Similar samples of every file are passed to 'handler' (keyed by file name) as soon as they are found,
+   * so the first results come after the first extraction, not after the whole directory.
+   * Handler may be called from several threads at once. If extraction, search or handler throws, pipeline stops
+   * and the first exception is rethrown after all threads finish.
+   * @return Number of files recommended for.
+   */
+  int StreamSamples(const std::string &samples_directory, const std::vector<float> &weights,
+                    const similarity::SearchOptions &options, const similarity::RecommendationHandler &handler) const;
+  /**
+   * SharedExtractor Resident extractor of recommender (nullptr before Load), it may be shared
+   * with other extracting code, e.g. Server.
+   */
+  std::shared_ptr<processing::Extractor> SharedExtractor() const { return _extractor; }
+
+ private:
+  struct Part {
+    Part() : store(nullptr), index(nullptr) {}
+    similarity::FeatureStore* store;
+    gaia2::TransfoChain history;
+    util::PcaProjection projection;
+    similarity::HnswIndex* index;
+  };
+
+  void Clear();
+  /**
+   * ExtractPoint Extracts descriptors of 'file_name' to raw point, returns nullptr on failure.
+   */
+  gaia2::Point* ExtractPoint(const std::string &file_name) const;
+  /**
+   * Project Maps raw 'point' to the space of global dataset of its type and returns it as a single query,
+   * 'part' is set to this dataset. Returns nullptr if point can't be mapped.
+   */
+  similarity::FeatureStore* Project(const gaia2::Point *point, const std::string &file_name, const Part **part) const;
+  similarity::FeatureStore* Query(const std::string &file_name, const Part **part) const;
+  std::vector<const similarity::HnswIndex*> Indexes(const Part &part, const similarity::SearchOptions &options) const;
+
+  std::string _profile;
+  std::string _models_directory;
+  std::map<std::string, Part> _types;
+  std::shared_ptr<processing::Extractor> _extractor;
+};
+
+}  // namespace audiq
+#endif  // PROJECT_AUDIQ_FILE_RECOMMENDER_H
@@ -0,0 +1,302 @@
+#include "audiq/audiq_hnsw_index.h"
+#include <cmath>
+#include <queue>
+#include <random>
+#include <fstream>
+#include <algorithm>
+#include <functional>
+#include "audiq/audiq_simd.h"
+#include "audiq/audiq_binary_io.h"
+
+#define HNSW_MAGIC   "AQHN"
+#define HNSW_VERSION 1
+
+namespace audiq {
+namespace similarity {
+
+using std::vector;
+
+namespace {
+
+// visited marks of searches of this thread (shared by all indexes): node is visited by search
+// if its mark is the search epoch, so marks aren't cleared between searches
+thread_local vector<unsigned> visited;
+thread_local unsigned visited_epoch = 0;
+
+/**
+ * NextEpoch Returns epoch of the next search of index with 'size' nodes.
+ */
+unsigned NextEpoch(size_t size) {
+  if ( visited.size() < size ) {
+    visited.resize(size, 0);
+  }
+  if ( ++visited_epoch == 0 ) {
+    std::fill(visited.begin(), visited.end(), 0);
+    visited_epoch = 1;
+  }
+  return visited_epoch;
+}
+
+}  // namespace
+
+HnswIndex::HnswIndex(int m, int ef_construction)
+    : _m(m), _ef_construction(ef_construction), _entry(-1), _max_level(-1) {}
+
+float HnswIndex::SquaredDistance(const float *a, int node) const {
+  return ActiveKernels().squared_distance(a, _pca.Row(node), _pca.Stride());
+}
+
+vector<Neighbour> HnswIndex::SearchLayer(const float *query, int entry, int ef, int level,
+                                         vector<unsigned> *visited, unsigned epoch) const {
+  // candidates - min-heap, found - max-heap (by squared distance)
+  std::priority_queue<Neighbour, vector<Neighbour>, std::greater<Neighbour> > candidates;
+  std::priority_queue<Neighbour> found;
+  Neighbour first(entry, SquaredDistance(query, entry));
+  candidates.push(first);
+  found.push(first);
+  (*visited)[entry] = epoch;
+  while ( !candidates.empty() ) {
+    Neighbour current = candidates.top();
+    if ( current.distance > found.top().distance && static_cast<int>(found.size()) >= ef ) {
+      break;
+    }
+    candidates.pop();
+    for ( int neighbour : _links[current.index][level] ) {
+      if ( (*visited)[neighbour] == epoch ) {
+        continue;
+      }
+      (*visited)[neighbour] = epoch;
+      float distance = SquaredDistance(query, neighbour);
+      if ( static_cast<int>(found.size()) < ef || distance < found.top().distance ) {
+        candidates.push(Neighbour(neighbour, distance));
+        found.push(Neighbour(neighbour, distance));
+        if ( static_cast<int>(found.size()) > ef ) {
+          found.pop();
+        }
+      }
+    }
+  }
+  vector<Neighbour> result;
+  while ( !found.empty() ) {
+    result.push_back(found.top());
+    found.pop();
+  }
+  std::reverse(result.begin(), result.end());
+  return result;
+}
+
+vector<int> HnswIndex::SelectNeighbours(const float *query, const vector<Neighbour> &candidates,
+                                        int m) const {
+  // heuristic of HNSW paper: skip candidates which are closer to already selected neighbour than to query
+  vector<int> selected;
+  for ( const auto &c : candidates ) {
+    if ( static_cast<int>(selected.size()) >= m ) {
+      break;
+    }
+    bool good = true;
+    for ( int s : selected ) {
+      if ( SquaredDistance(_pca.Row(c.index), s) < c.distance ) {
+        good = false;
+        break;
+      }
+    }
+    if ( good ) {
+      selected.push_back(c.index);
+    }
+  }
+  // fill up with the nearest skipped candidates
+  for ( const auto &c : candidates ) {
+    if ( static_cast<int>(selected.size()) >= m ) {
+      break;
+    }
+    if ( std::find(selected.begin(), selected.end(), c.index) == selected.end() ) {
+      selected.push_back(c.index);
+    }
+  }
+  return selected;
+}
+
+void HnswIndex::Shrink(int node, int level) {
+  const int max_links = level == 0 ? 2 * _m : _m;
+  vector<int> &links = _links[node][level];
+  if ( static_cast<int>(links.size()) <= max_links ) {
+    return;
+  }
+  vector<Neighbour> candidates;
+  for ( int l : links ) {
+    candidates.push_back(Neighbour(l, SquaredDistance(_pca.Row(node), l)));
+  }
+  std::sort(candidates.begin(), candidates.end());
+  links = SelectNeighbours(_pca.Row(node), candidates, max_links);
+}
+
+void HnswIndex::Insert(int node, int level) {
+  _links[node].resize(level + 1);
+  if ( _entry < 0 ) {
+    _entry = node;
+    _max_level = level;
+    return;
+  }
+  const float* query = _pca.Row(node);
+  int entry = _entry;
+  for ( int l = _max_level; l > level; --l ) {
+    entry = SearchLayer(query, entry, 1, l, &visited, NextEpoch(_names.size())).front().index;
+  }
+  for ( int l = std::min(level, _max_level); l >= 0; --l ) {
+    vector<Neighbour> candidates = SearchLayer(query, entry, _ef_construction, l, &visited,
+                                               NextEpoch(_names.size()));
+    _links[node][l] = SelectNeighbours(query, candidates, _m);
+    for ( int neighbour : _links[node][l] ) {
+      _links[neighbour][l].push_back(node);
+      Shrink(neighbour, l);
+    }
+    entry = candidates.front().index;
+  }
+  if ( level > _max_level ) {
+    _max_level = level;
+    _entry = node;
+  }
+}
+
+void HnswIndex::Build(const FeatureStore &store) {
+  const int size = store.Size();
+  _pca.Resize(size, PCA_DIMENSION);
+  _names.resize(size);
+  _links.assign(size, vector<vector<int> >());
+  _entry = -1;
+  _max_level = -1;
+  for ( int i = 0; i < size; ++i ) {
+    std::copy(store.Pca().Row(i), store.Pca().Row(i) + PCA_DIMENSION, _pca.Row(i));
+    _names[i] = store.PointName(i);
+  }
+  std::mt19937 generator(0);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  const double level_multiplier = 1.0 / std::log(static_cast<double>(std::max(2, _m)));
+  for ( int i = 0; i < size; ++i ) {
+    int level = static_cast<int>(-std::log(1.0 - uniform(generator)) * level_multiplier);
+    Insert(i, level);
+  }
+}
+
+vector<Neighbour> HnswIndex::Search(const float *pca, int k, int ef) const {
+  if ( _entry < 0 ) {
+    return vector<Neighbour>();
+  }
+  int entry = _entry;
+  for ( int l = _max_level; l > 0; --l ) {
+    entry = SearchLayer(pca, entry, 1, l, &visited, NextEpoch(_names.size())).front().index;
+  }
+  vector<Neighbour> result = SearchLayer(pca, entry, std::max(ef, k), 0, &visited, NextEpoch(_names.size()));
+  if ( static_cast<int>(result.size()) > k ) {
+    result.resize(k);
+  }
+  for ( auto &n : result ) {
+    n.distance = std::sqrt(n.distance);
+  }
+  return result;
+}
+
+bool HnswIndex::Save(const std::string &file_name) const {
+  std::ofstream out(file_name, std::ios::binary);
+  util::WriteHeader(out, HNSW_MAGIC, HNSW_VERSION);
+  util::WriteValue<int32_t>(out, _m);
+  util::WriteValue<int32_t>(out, _ef_construction);
+  util::WriteValue<int32_t>(out, _entry);
+  util::WriteValue<int32_t>(out, _max_level);
+  util::WriteValue<int32_t>(out, Size());
+  for ( int i = 0; i < Size(); ++i ) {
+    util::WriteString(out, _names[i].toStdString());
+    util::WriteArray(out, _pca.Row(i), PCA_DIMENSION);
+    util::WriteValue<int32_t>(out, _links[i].size());
+    for ( const auto &links : _links[i] ) {
+      util::WriteVector(out, links);
+    }
+  }
+  return static_cast<bool>(out);
+}
+
+bool HnswIndex::Load(const std::string &file_name) {
+  std::ifstream in(file_name, std::ios::binary);
+  int32_t m, ef_construction, entry, max_level, size;
+  _entry = -1;
+  _max_level = -1;
+  _names.clear();
+  _links.clear();
+  if ( !util::ReadHeader(in, HNSW_MAGIC, HNSW_VERSION) || !util::ReadValue(in, &m)
+       || !util::ReadValue(in, &ef_construction) || !util::ReadValue(in, &entry)
+       || !util::ReadValue(in, &max_level) || !util::ReadValue(in, &size)
+       || m <= 0 || ef_construction <= 0 || size < 0 || entry < -1 || entry >= size
+       || (entry < 0) != (size == 0) || max_level < (size == 0 ? -1 : 0)
+       || !util::FitsStream(in, static_cast<uint64_t>(size) * PCA_DIMENSION * sizeof(float)) ) {
+    return false;
+  }
+  _pca.Resize(size, PCA_DIMENSION);
+  vector<QString> names(size);
+  vector<vector<vector<int> > > links(size);
+  std::string name;
+  for ( int i = 0; i < size; ++i ) {
+    int32_t levels;
+    // every level of node is stored with the size of its links
+    if ( !util::ReadString(in, &name) || !util::ReadArray(in, _pca.Row(i), PCA_DIMENSION)
+         || !util::ReadValue(in, &levels) || levels < 1 || levels > max_level + 1
+         || !util::FitsStream(in, static_cast<uint64_t>(levels) * sizeof(uint64_t)) ) {
+      return false;
+    }
+    names[i] = QString::fromStdString(name);
+    links[i].resize(levels);
+    for ( auto &l : links[i] ) {
+      if ( !util::ReadVector(in, &l) ) {
+        return false;
+      }
+    }
+  }
+  // graph is searched without bounds checks, so every link must point to a node present on its level
+  if ( size > 0 && static_cast<int>(links[entry].size()) != max_level + 1 ) {
+    return false;
+  }
+  for ( int i = 0; i < size; ++i ) {
+    for ( size_t level = 0; level < links[i].size(); ++level ) {
+      for ( int neighbour : links[i][level] ) {
+        if ( neighbour < 0 || neighbour >= size || links[neighbour].size() <= level ) {
+          return false;
+        }
+      }
+    }
+  }
+  _m = m;
+  _ef_construction = ef_construction;
+  _entry = entry;
+  _max_level = max_level;
+  _names.swap(names);
+  _links.swap(links);
+  return true;
+}
+
+bool BuildDataSetIndex(const std::string &dataset_name) {
+  DataSet dataset;
+  dataset.load(QString::fromStdString(dataset_name + ".db"));
+  FeatureStore* store = BuildFeatureStore(&dataset);
+  HnswIndex index;
+  index.Build(*store);
+  delete store;
+  return index.Save(dataset_name + ".hnsw");
+}
+
+HnswIndex* LoadDataSetIndex(const std::string &dataset_name) {
+  // index is rebuilt if dataset was changed after it
+  bool outdated = !filesystem::exists(dataset_name + ".hnsw")
+                  || filesystem::last_write_time(dataset_name + ".db")
+                     > filesystem::last_write_time(dataset_name + ".hnsw");
+  if ( outdated && !BuildDataSetIndex(dataset_name) ) {
+    return nullptr;
+  }
+  HnswIndex* index = new HnswIndex;
+  if ( !index->Load(dataset_name + ".hnsw") ) {
+    delete index;
+    return nullptr;
+  }
+  return index;
+}
+
+}  // namespace similarity
+}  // namespace audiq
@@ -0,0 +1,75 @@
+#ifndef PROJECT_AUDIQ_HNSW_INDEX_H
+#define PROJECT_AUDIQ_HNSW_INDEX_H
+
+#include <string>
+#include <vector>
+#include <QString>
+#include "audiq/audiq_search.h"
+#include "audiq/audiq_feature_store.h"
+
+#define HNSW_M               16
+#define HNSW_EF_CONSTRUCTION 100
+#define HNSW_EF_SEARCH       400
+
+namespace audiq {
+namespace similarity {
+
+/**
+ * @brief HnswIndex Hierarchical navigable small world graph over PCA block (Euclidean distance).
+ * Index keeps its own copy of PCA vectors and point names, so it's independent of the feature store
+ * it was built from: nodes are mapped back to stores by point names.
+ */
+class HnswIndex {
+ public:
+  explicit HnswIndex(int m = HNSW_M, int ef_construction = HNSW_EF_CONSTRUCTION);
+
+  void Build(const FeatureStore &store);
+  /**
+   * Search Approximate 'k' nearest (by PCA) nodes to 'pca', 'ef' is the size of dynamic candidates list
+   * (the larger 'ef' the higher recall and latency).
+   */
+  std::vector<Neighbour> Search(const float *pca, int k, int ef = HNSW_EF_SEARCH) const;
+
+  int Size() const { return static_cast<int>(_names.size()); }
+  const QString& PointName(int node) const { return _names[node]; }
+
+  bool Save(const std::string &file_name) const;
+  /**
+   * Load Loads index saved with Save, returns false (and leaves index empty) if file is corrupt:
+   * sizes, levels and links of nodes are checked.
+   */
+  bool Load(const std::string &file_name);
+
+ private:
+  float SquaredDistance(const float *a, int node) const;
+  std::vector<Neighbour> SearchLayer(const float *query, int entry, int ef, int level,
+                                     std::vector<unsigned> *visited, unsigned epoch) const;
+  std::vector<int> SelectNeighbours(const float *query, const std::vector<Neighbour> &candidates,
+                                    int m) const;
+  void Insert(int node, int level);
+  void Shrink(int node, int level);
+
+  int _m;
+  int _ef_construction;
+  int _entry;
+  int _max_level;
+  AlignedBlock<float> _pca;
+  std::vector<QString> _names;
+  // _links[node][level] - neighbours of node on level
+  std::vector<std::vector<std::vector<int> > > _links;
+};
+
+/**
+ * @brief BuildDataSetIndex Builds HNSW index of dataset 'dataset_name'.db and saves it as 'dataset_name'.hnsw.
+ */
+bool BuildDataSetIndex(const std::string &dataset_name);
+/**
+ * @brief LoadDataSetIndex Loads index 'dataset_name'.hnsw, index is (re)built first if there is no such file
+ * or it's older than 'dataset_name'.db.
+ * Returns nullptr on failure.
+ */
+HnswIndex* LoadDataSetIndex(const std::string &dataset_name);
+
+}  // namespace similarity
+}  // namespace audiq
+#endif  // PROJECT_AUDIQ_HNSW_INDEX_H
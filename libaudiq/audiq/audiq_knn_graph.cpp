@@ -0,0 +1,239 @@
+#include "audiq/audiq_knn_graph.h"
+#include <fstream>
+#include <algorithm>
+#include "gaia2/dataset.h"
+#include "audiq/audiq_binary_io.h"
+
+#define KNN_MAGIC   "AQKN"
+#define KNN_VERSION 1
+
+namespace audiq {
+namespace similarity {
+
+using std::vector;
+
+namespace {
+
+bool SameWeights(const MetricWeights &a, const MetricWeights &b) {
+  return a.pca == b.pca && a.mfcc == b.mfcc && a.highlevel == b.highlevel;
+}
+
+}  // namespace
+
+KnnGraph::KnnGraph() : _k(0) {}
+
+void KnnGraph::SetPoints(const FeatureStore &store) {
+  _names.resize(store.Size());
+  _file_names.resize(store.Size());
+  _index.clear();
+  _file_index.clear();
+  for ( int i = 0; i < store.Size(); ++i ) {
+    _names[i] = store.PointName(i);
+    _file_names[i] = store.FileName(i);
+    _index.insert(_names[i], i);
+    _file_index[_file_names[i]] = i;
+  }
+}
+
+void KnnGraph::Build(const FeatureStore &store, int k, const MetricWeights &weights, int threads) {
+  _k = k;
+  _weights = weights;
+  SetPoints(store);
+  vector<int> rows(store.Size());
+  for ( int i = 0; i < store.Size(); ++i ) {
+    rows[i] = i;
+  }
+  // one more neighbour, because every point is the nearest to itself
+  vector<vector<Neighbour> > found = BatchSearch(store, store, rows, k + 1, weights, vector<bool>(), threads);
+  _neighbours.assign(store.Size(), vector<Neighbour>());
+  for ( int i = 0; i < store.Size(); ++i ) {
+    for ( const auto &n : found[i] ) {
+      if ( n.index != i && static_cast<int>(_neighbours[i].size()) < k ) {
+        _neighbours[i].push_back(n);
+      }
+    }
+  }
+}
+
+bool KnnGraph::Add(const FeatureStore &store, int threads) {
+  vector<int> old_rows(Size());
+  vector<bool> is_old(store.Size(), false);
+  for ( int i = 0; i < Size(); ++i ) {
+    old_rows[i] = store.IndexOf(_names[i]);
+    if ( old_rows[i] < 0 ) {
+      return false;
+    }
+    is_old[old_rows[i]] = true;
+  }
+  vector<int> new_rows;
+  for ( int i = 0; i < store.Size(); ++i ) {
+    if ( !is_old[i] ) {
+      new_rows.push_back(i);
+    }
+  }
+  // rows of graph become rows of store
+  vector<vector<Neighbour> > neighbours(store.Size());
+  for ( int i = 0; i < Size(); ++i ) {
+    for ( const auto &n : _neighbours[i] ) {
+      neighbours[old_rows[i]].push_back(Neighbour(old_rows[n.index], n.distance));
+    }
+  }
+  if ( !new_rows.empty() ) {
+    vector<vector<Neighbour> > found = BatchSearch(store, store, new_rows, _k + 1, _weights,
+                                                   vector<bool>(), threads);
+    for ( size_t q = 0; q < new_rows.size(); ++q ) {
+      for ( const auto &n : found[q] ) {
+        if ( n.index != new_rows[q] && static_cast<int>(neighbours[new_rows[q]].size()) < _k ) {
+          neighbours[new_rows[q]].push_back(n);
+        }
+      }
+    }
+    // only new points may become neighbours of old ones
+    vector<vector<Neighbour> > closer = BatchSearch(store, store, old_rows, _k, _weights, is_old, threads);
+    for ( int i = 0; i < Size(); ++i ) {
+      TopK top(_k);
+      for ( const auto &n : neighbours[old_rows[i]] ) {
+        top.Push(n.index, n.distance);
+      }
+      for ( const auto &n : closer[i] ) {
+        top.Push(n.index, n.distance);
+      }
+      neighbours[old_rows[i]] = top.Sorted();
+    }
+  }
+  SetPoints(store);
+  _neighbours.swap(neighbours);
+  return true;
+}
+
+int KnnGraph::IndexOf(const std::string &sample) const {
+  int i = _index.value(QString::fromStdString(sample), -1);
+  if ( i < 0 ) {
+    auto found = _file_index.find(sample);
+    i = found == _file_index.end() ? -1 : found->second;
+  }
+  return i;
+}
+
+vector<std::pair<std::string, float> > KnnGraph::Lookup(const std::string &sample, int k) const {
+  vector<std::pair<std::string, float> > similar;
+  int i = IndexOf(sample);
+  if ( i < 0 ) {
+    return similar;
+  }
+  for ( const auto &n : _neighbours[i] ) {
+    if ( static_cast<int>(similar.size()) == k ) {
+      break;
+    }
+    similar.push_back(std::make_pair(_file_names[n.index], n.distance));
+  }
+  return similar;
+}
+
+bool KnnGraph::Save(const std::string &file_name) const {
+  std::ofstream out(file_name, std::ios::binary);
+  util::WriteHeader(out, KNN_MAGIC, KNN_VERSION);
+  util::WriteValue<int32_t>(out, _k);
+  util::WriteValue<float>(out, _weights.pca);
+  util::WriteValue<float>(out, _weights.mfcc);
+  util::WriteValue<float>(out, _weights.highlevel);
+  util::WriteValue<int32_t>(out, Size());
+  vector<int32_t> indexes;
+  vector<float> distances;
+  for ( int i = 0; i < Size(); ++i ) {
+    util::WriteString(out, _names[i].toStdString());
+    util::WriteString(out, _file_names[i]);
+    indexes.clear();
+    distances.clear();
+    for ( const auto &n : _neighbours[i] ) {
+      indexes.push_back(n.index);
+      distances.push_back(n.distance);
+    }
+    util::WriteVector(out, indexes);
+    util::WriteVector(out, distances);
+  }
+  return static_cast<bool>(out);
+}
+
+bool KnnGraph::Load(const std::string &file_name) {
+  std::ifstream in(file_name, std::ios::binary);
+  int32_t k, size;
+  _k = 0;
+  _names.clear();
+  _file_names.clear();
+  _neighbours.clear();
+  _index.clear();
+  _file_index.clear();
+  // every point takes at least sizes of its two names and two vectors
+  if ( !util::ReadHeader(in, KNN_MAGIC, KNN_VERSION) || !util::ReadValue(in, &k)
+       || !util::ReadValue(in, &_weights.pca) || !util::ReadValue(in, &_weights.mfcc)
+       || !util::ReadValue(in, &_weights.highlevel) || !util::ReadValue(in, &size) || k <= 0 || size < 0
+       || !util::FitsStream(in, static_cast<uint64_t>(size) * 2 * (sizeof(uint32_t) + sizeof(uint64_t))) ) {
+    return false;
+  }
+  vector<QString> names(size);
+  vector<std::string> file_names(size);
+  vector<vector<Neighbour> > neighbours(size);
+  std::string name;
+  vector<int32_t> indexes;
+  vector<float> distances;
+  for ( int i = 0; i < size; ++i ) {
+    if ( !util::ReadString(in, &name) || !util::ReadString(in, &file_names[i])
+         || !util::ReadVector(in, &indexes) || !util::ReadVector(in, &distances)
+         || indexes.size() != distances.size() ) {
+      return false;
+    }
+    names[i] = QString::fromStdString(name);
+    for ( size_t j = 0; j < indexes.size(); ++j ) {
+      if ( indexes[j] < 0 || indexes[j] >= size ) {
+        return false;
+      }
+      neighbours[i].push_back(Neighbour(indexes[j], distances[j]));
+    }
+  }
+  // graph is changed only if the whole file is valid
+  _k = k;
+  _names.swap(names);
+  _file_names.swap(file_names);
+  _neighbours.swap(neighbours);
+  for ( int i = 0; i < size; ++i ) {
+    _index.insert(_names[i], i);
+    _file_index[_file_names[i]] = i;
+  }
+  return true;
+}
+
+KnnGraph* LoadDataSetKnnGraph(const std::string &dataset_name, int k, const MetricWeights &weights) {
+  std::string file_name = dataset_name + ".knn";
+  if ( !filesystem::exists(file_name)
+       || filesystem::last_write_time(dataset_name + ".db") > filesystem::last_write_time(file_name) ) {
+    return nullptr;
+  }
+  KnnGraph* graph = new KnnGraph;
+  if ( !graph->Load(file_name) || graph->K() != k || !SameWeights(graph->Weights(), weights) ) {
+    delete graph;
+    return nullptr;
+  }
+  return graph;
+}
+
+bool BuildDataSetKnnGraph(const std::string &dataset_name, int k, const MetricWeights &weights, int threads) {
+  std::string file_name = dataset_name + ".knn";
+  KnnGraph graph;
+  bool loaded = filesystem::exists(file_name) && graph.Load(file_name)
+                && graph.K() == k && SameWeights(graph.Weights(), weights);
+  if ( loaded && filesystem::last_write_time(dataset_name + ".db") <= filesystem::last_write_time(file_name) ) {
+    return true;
+  }
+  DataSet dataset;
+  dataset.load(QString::fromStdString(dataset_name + ".db"));
+  FeatureStore* store = BuildFeatureStore(&dataset);
+  if ( !loaded || !graph.Add(*store, threads) ) {
+    graph.Build(*store, k, weights, threads);
+  }
+  delete store;
+  return graph.Save(file_name);
+}
+
+}  // namespace similarity
+}  // namespace audiq
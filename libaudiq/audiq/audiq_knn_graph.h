@@ -0,0 +1,81 @@
+#ifndef PROJECT_AUDIQ_KNN_GRAPH_H
+#define PROJECT_AUDIQ_KNN_GRAPH_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <unordered_map>
+#include <QHash>
+#include <QString>
+#include "audiq/audiq_search.h"
+#include "audiq/audiq_feature_store.h"
+#include "audiq/audiq_native_metric.h"
+
+#define KNN_K 50
+
+namespace audiq {
+namespace similarity {
+
+/**
+ * @brief KnnGraph Exact 'K' nearest neighbours of every point of global dataset under audiq metric
+ * with fixed weights, so "more like this" for samples of the dataset is a lookup.
+ */
+class KnnGraph {
+ public:
+  KnnGraph();
+
+  /**
+   * Build Computes neighbours of every point of 'store' (point itself excluded) with BatchSearch
+   * on 'threads' threads (0 - number of hardware threads).
+   */
+  void Build(const FeatureStore &store, int k, const MetricWeights &weights, int threads = 0);
+  /**
+   * Add Adds points of 'store' which aren't in graph: they are searched in the whole store and
+   * neighbours of old points are updated with new points only.
+   * @return false if 'store' doesn't contain some point of graph (then graph must be rebuilt).
+   */
+  bool Add(const FeatureStore &store, int threads = 0);
+  /**
+   * Lookup Returns at most 'k' neighbours (file names and distances) of sample with point name
+   * or file name 'sample', empty if there is no such sample.
+   */
+  std::vector<std::pair<std::string, float> > Lookup(const std::string &sample, int k) const;
+
+  int Size() const { return static_cast<int>(_names.size()); }
+  int K() const { return _k; }
+  const MetricWeights& Weights() const { return _weights; }
+
+  bool Save(const std::string &file_name) const;
+  bool Load(const std::string &file_name);
+
+ private:
+  void SetPoints(const FeatureStore &store);
+  int IndexOf(const std::string &sample) const;
+
+  int _k;
+  MetricWeights _weights;
+  std::vector<QString> _names;
+  std::vector<std::string> _file_names;
+  QHash<QString, int> _index;
+  std::unordered_map<std::string, int> _file_index;
+  // _neighbours[i] - neighbours of point i sorted by distance
+  std::vector<std::vector<Neighbour> > _neighbours;
+};
+
+/**
+ * @brief LoadDataSetKnnGraph Loads graph 'dataset_name'.knn saved by BuildDataSetKnnGraph with the same 'k'
+ * and 'weights'. Returns nullptr if there is no such graph or 'dataset_name'.db is newer than graph
+ * (graph must be updated by BuildDataSetKnnGraph first).
+ */
+KnnGraph* LoadDataSetKnnGraph(const std::string &dataset_name, int k, const MetricWeights &weights);
+/**
+ * @brief BuildDataSetKnnGraph Builds graph of 'dataset_name'.db offline and saves it to 'dataset_name'.knn.
+ * If graph was built with the same 'k' and 'weights' and dataset is newer, new points are added to it
+ * (or it's rebuilt if some points were removed), graph which is up to date isn't changed.
+ * Returns false on failure.
+ */
+bool BuildDataSetKnnGraph(const std::string &dataset_name, int k, const MetricWeights &weights, int threads = 0);
+
+}  // namespace similarity
+}  // namespace audiq
+#endif  // PROJECT_AUDIQ_KNN_GRAPH_H
@@ -0,0 +1,166 @@
+#include "audiq/audiq_metadata_index.h"
+#include <sstream>
+#include <cstdlib>
+#include <iterator>
+#include <algorithm>
+
+namespace audiq {
+namespace similarity {
+
+using std::vector;
+
+namespace {
+
+vector<int> Intersect(const vector<int> &a, const vector<int> &b) {
+  vector<int> result;
+  std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(result));
+  return result;
+}
+
+bool ParseNumber(const std::string &text, float *value) {
+  if ( text.empty() ) {
+    return true;
+  }
+  char* end = nullptr;
+  *value = std::strtof(text.c_str(), &end);
+  return *end == '\0';
+}
+
+}  // namespace
+
+bool ParseSampleFilter(const std::string &text, SampleFilter *filter) {
+  *filter = SampleFilter();
+  std::istringstream input(text);
+  std::string token;
+  while ( input >> token ) {
+    size_t equal = token.find('=');
+    if ( equal == std::string::npos || equal == 0 || equal + 1 == token.size() ) {
+      return false;
+    }
+    std::string name = token.substr(0, equal), value = token.substr(equal + 1);
+    if ( name != "duration" ) {
+      filter->labels[name] = value;
+      continue;
+    }
+    size_t colon = value.find(':');
+    if ( colon == std::string::npos || !ParseNumber(value.substr(0, colon), &filter->min_duration)
+         || !ParseNumber(value.substr(colon + 1), &filter->max_duration) ) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::string SampleFilterToString(const SampleFilter &filter) {
+  std::ostringstream text;
+  for ( const auto &label : filter.labels ) {
+    text << label.first << "=" << label.second << " ";
+  }
+  if ( filter.min_duration > 0.0 || filter.max_duration > 0.0 ) {
+    text << "duration=";
+    if ( filter.min_duration > 0.0 ) {
+      text << filter.min_duration;
+    }
+    text << ":";
+    if ( filter.max_duration > 0.0 ) {
+      text << filter.max_duration;
+    }
+  }
+  std::string result = text.str();
+  return result.empty() || result.back() != ' ' ? result : result.substr(0, result.size() - 1);
+}
+
+MetadataIndex::MetadataIndex(const FeatureStore &store) : _size(store.Size()) {
+  for ( size_t c = 0; c < store.LabelNames().size(); ++c ) {
+    for ( int i = 0; i < store.Size(); ++i ) {
+      const std::string &value = store.Label(i, c);
+      if ( !value.empty() ) {
+        _partitions[std::make_pair(store.LabelNames()[c], value)].push_back(i);
+      }
+    }
+  }
+  _by_duration.resize(store.Size());
+  for ( int i = 0; i < store.Size(); ++i ) {
+    _by_duration[i] = i;
+  }
+  std::sort(_by_duration.begin(), _by_duration.end(), [&store](int a, int b) {
+    return store.Duration(a) < store.Duration(b);
+  });
+  for ( auto i : _by_duration ) {
+    _durations.push_back(store.Duration(i));
+  }
+}
+
+vector<int> MetadataIndex::Rows(const SampleFilter &filter) const {
+  vector<int> rows;
+  bool all = true;
+  for ( const auto &label : filter.labels ) {
+    auto found = _partitions.find(label);
+    if ( found == _partitions.end() ) {
+      return vector<int>();
+    }
+    rows = all ? found->second : Intersect(rows, found->second);
+    all = false;
+  }
+  if ( filter.min_duration > 0.0 || filter.max_duration > 0.0 ) {
+    auto begin = std::lower_bound(_durations.begin(), _durations.end(), filter.min_duration);
+    auto end = filter.max_duration > 0.0
+               ? std::upper_bound(_durations.begin(), _durations.end(), filter.max_duration)
+               : _durations.end();
+    vector<int> in_range;
+    if ( begin < end ) {
+      in_range.assign(_by_duration.begin() + (begin - _durations.begin()),
+                      _by_duration.begin() + (end - _durations.begin()));
+    }
+    std::sort(in_range.begin(), in_range.end());
+    rows = all ? in_range : Intersect(rows, in_range);
+    all = false;
+  }
+  if ( all ) {
+    rows.resize(_size);
+    for ( int i = 0; i < _size; ++i ) {
+      rows[i] = i;
+    }
+  }
+  return rows;
+}
+
+size_t MetadataIndex::Bytes() const {
+  size_t bytes = _durations.size() * sizeof(float) + _by_duration.size() * sizeof(int);
+  for ( const auto &partition : _partitions ) {
+    bytes += partition.second.size() * sizeof(int);
+  }
+  return bytes;
+}
+
+bool Matches(const FeatureStore &store, int i, const SampleFilter &filter) {
+  for ( const auto &label : filter.labels ) {
+    int column = store.LabelColumn(label.first);
+    if ( column < 0 || store.Label(i, column) != label.second ) {
+      return false;
+    }
+  }
+  return store.Duration(i) >= filter.min_duration
+         && (filter.max_duration <= 0.0 || store.Duration(i) <= filter.max_duration);
+}
+
+vector<int> MatchingRows(const FeatureStore &store, const SampleFilter &filter) {
+  vector<int> rows;
+  for ( int i = 0; i < store.Size(); ++i ) {
+    if ( Matches(store, i, filter) ) {
+      rows.push_back(i);
+    }
+  }
+  return rows;
+}
+
+FeatureStore* Partition(const FeatureStore &store, const vector<int> &rows) {
+  FeatureStore* partition = new FeatureStore(rows.size(), store.HighlevelNames());
+  for ( size_t i = 0; i < rows.size(); ++i ) {
+    partition->CopyRow(i, store, rows[i]);
+  }
+  return partition;
+}
+
+}  // namespace similarity
+}  // namespace audiq
@@ -0,0 +1,53 @@
+#ifndef PROJECT_AUDIQ_METADATA_INDEX_H
+#define PROJECT_AUDIQ_METADATA_INDEX_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <utility>
+#include "audiq/audiq_search_options.h"
+#include "audiq/audiq_feature_store.h"
+
+namespace audiq {
+namespace similarity {
+
+/**
+ * @brief MetadataIndex Partitions of feature store by metadata: sorted rows of every label value
+ * and rows sorted by duration, so rows matching SampleFilter are found without scanning the store.
+ */
+class MetadataIndex {
+ public:
+  explicit MetadataIndex(const FeatureStore &store);
+
+  /**
+   * Rows Returns sorted rows of store which match 'filter' (all rows if filter is empty).
+   */
+  std::vector<int> Rows(const SampleFilter &filter) const;
+  size_t Bytes() const;
+
+ private:
+  int _size;
+  // (label, value) -> sorted rows
+  std::map<std::pair<std::string, std::string>, std::vector<int> > _partitions;
+  std::vector<float> _durations;
+  std::vector<int> _by_duration;
+};
+
+/**
+ * @brief Matches Returns true if row 'i' of 'store' matches 'filter'.
+ */
+bool Matches(const FeatureStore &store, int i, const SampleFilter &filter);
+
+/**
+ * @brief MatchingRows Same as MetadataIndex::Rows, but scans 'store' (for stores without index).
+ */
+std::vector<int> MatchingRows(const FeatureStore &store, const SampleFilter &filter);
+
+/**
+ * @brief Partition Creates store of 'rows' of 'store'.
+ */
+FeatureStore* Partition(const FeatureStore &store, const std::vector<int> &rows);
+
+}  // namespace similarity
+}  // namespace audiq
+#endif  // PROJECT_AUDIQ_METADATA_INDEX_H
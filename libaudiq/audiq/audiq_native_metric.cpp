@@ -0,0 +1,59 @@
+#include "audiq/audiq_native_metric.h"
+#include <cmath>
+#include <algorithm>
+#include "audiq/audiq_simd.h"
+
+namespace audiq {
+namespace similarity {
+
+namespace {
+
+constexpr int pca_stride = AlignedBlock<float>::PaddedDimension(PCA_DIMENSION);
+constexpr int mfcc_terms_stride = AlignedBlock<float>::PaddedDimension(MFCC_TERMS);
+
+}  // namespace
+
+float PcaDistance(const float *a, const float *b) {
+  return std::sqrt(ActiveKernels().squared_distance(a, b, pca_stride));
+}
+
+float MfccDistance(const FeatureStore &a, int i, const FeatureStore &b, int j) {
+  float sum = ActiveKernels().dot_pair(b.MfccIcovTerms().Row(j), a.MfccCovTerms().Row(i),
+                                       a.MfccIcovTerms().Row(i), b.MfccCovTerms().Row(j), mfcc_terms_stride);
+  // rounding can make distance of (almost) equal gaussians slightly negative
+  return std::max(0.0f, 0.5f * sum - MFCC_DIMENSION);
+}
+
+float HighlevelDistance(const float *a, const float *b, int dimension) {
+  if ( dimension == 0 ) {
+    return 0.0;
+  }
+  return PearsonDistance(ActiveKernels().moments(a, b, AlignedBlock<float>::PaddedDimension(dimension)), dimension);
+}
+
+float PearsonDistance(const Moments &m, int dimension) {
+  float ab = m.ab - m.a * m.b / dimension;
+  float aa = m.aa - m.a * m.a / dimension;
+  float bb = m.bb - m.b * m.b / dimension;
+  // variance of constant vector may be not exactly zero after rounding
+  if ( aa <= PEARSON_EPSILON * m.aa || bb <= PEARSON_EPSILON * m.bb ) {
+    return 1.0;
+  }
+  return std::max(0.0f, 1.0f - ab / std::sqrt(aa * bb));
+}
+
+Components ComponentDistances(const FeatureStore &a, int i, const FeatureStore &b, int j) {
+  Components c;
+  c.pca = Compress(PcaDistance(a.Pca().Row(i), b.Pca().Row(j)));
+  c.mfcc = Compress(MfccDistance(a, i, b, j));
+  c.highlevel = Compress(HighlevelDistance(a.Highlevel().Row(i), b.Highlevel().Row(j),
+                                           a.Highlevel().Dimension()));
+  return c;
+}
+
+float Distance(const FeatureStore &a, int i, const FeatureStore &b, int j, const MetricWeights &weights) {
+  return Combine(ComponentDistances(a, i, b, j), weights);
+}
+
+}  // namespace similarity
+}  // namespace audiq
@@ -0,0 +1,77 @@
+#ifndef PROJECT_AUDIQ_NATIVE_METRIC_H
+#define PROJECT_AUDIQ_NATIVE_METRIC_H
+
+#include <cmath>
+#include <vector>
+#include "audiq/audiq_simd.h"
+#include "audiq/audiq_config.h"
+#include "audiq/audiq_feature_store.h"
+
+// alpha of ExponentialCompress used by similarity::CompressedDefaultMetric
+#define COMPRESS_ALPHA 0.1f
+// relative variance below which highlevel probabilities are treated as constant
+#define PEARSON_EPSILON 1e-6f
+
+namespace audiq {
+namespace similarity {
+
+/**
+ * @brief MetricWeights Coefficients of LinearCombination in audiq metric.
+ */
+struct MetricWeights {
+  MetricWeights(float pca = 1.0, float mfcc = 1.0, float highlevel = 1.0)
+      : pca(pca), mfcc(mfcc), highlevel(highlevel) {}
+  explicit MetricWeights(const std::vector<float> &weights)
+      : pca(weights.at(0)), mfcc(weights.at(1)), highlevel(weights.at(2)) {}
+  float pca;
+  float mfcc;
+  float highlevel;
+};
+
+/**
+ * @brief Components Compressed distances of each component of audiq metric.
+ */
+struct Components {
+  float pca;
+  float mfcc;
+  float highlevel;
+};
+
+inline float Compress(float distance) {
+  return 1.0f - std::exp(-COMPRESS_ALPHA * distance);
+}
+
+/**
+ * PcaDistance Euclidean distance between two PCA_DIMENSION vectors.
+ * @note Vectors passed to metric functions must be zero-padded up to AlignedBlock stride
+ * (rows of FeatureStore are), they are processed with ActiveKernels().
+ */
+float PcaDistance(const float *a, const float *b);
+/**
+ * MfccDistance Symmetric Kullback-Leibler distance between MFCC gaussians of a[i] and b[j],
+ * computed from precomputed mfcc terms of stores.
+ */
+float MfccDistance(const FeatureStore &a, int i, const FeatureStore &b, int j);
+/**
+ * HighlevelDistance Pearson distance (1 - r) between highlevel probabilities, all weights are 1.
+ */
+float HighlevelDistance(const float *a, const float *b, int dimension);
+/**
+ * PearsonDistance Pearson distance (1 - r) of two 'dimension' vectors given by their moments.
+ */
+float PearsonDistance(const Moments &m, int dimension);
+
+Components ComponentDistances(const FeatureStore &a, int i, const FeatureStore &b, int j);
+
+inline float Combine(const Components &c, const MetricWeights &w) {
+  return w.pca * c.pca + w.mfcc * c.mfcc + w.highlevel * c.highlevel;
+}
+/**
+ * @brief Distance Native implementation of similarity::CompressedDefaultMetric between a[i] and b[j].
+ * @note Stores must have the same 'HighlevelNames()'.
+ */
+float Distance(const FeatureStore &a, int i, const FeatureStore &b, int j, const MetricWeights &weights);
+
+}  // namespace similarity
+}  // namespace audiq
+#endif  // PROJECT_AUDIQ_NATIVE_METRIC_H
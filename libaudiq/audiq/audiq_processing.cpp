@@ -18,6 +18,85 @@ using essentia::standard::AlgorithmFactory;
 enum SampleType { percussion, vocal, melody };
 map<string, SampleType> name_to_type;
 
+std::mutex& ExtractionMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+Extractor::Extractor(const string &profile, const string &models_directory) {
+  std::lock_guard<std::mutex> lock(ExtractionMutex());
+  if ( !essentia::isInitialized() )
+    essentia::init();
+  InitializeMap();
+  _lowlevel = new extractor::AudiqMusicExtractor;
+  if ( filesystem::exists(profile) ) {
+    _lowlevel->configure("profile", profile);
+  } else {
+    _lowlevel->configure("lowlevelSilentFrames", "noise",
+                         "tonalSilentFrames", "noise");
+  }
+  vector<string> models_common = { models_directory + MODEL_BASS,
+                                   models_directory + MODEL_SHOT_OR_LOOP,
+                                   models_directory + MODEL_SYNTH_OR_ACOUSTIC };
+  _type = AlgorithmFactory::create("MusicExtractorSVM", "svms", vector<string>{ models_directory + MODEL_TYPE });
+  _phrase = AlgorithmFactory::create("MusicExtractorSVM", "svms", vector<string>{ models_directory + MODEL_PHRASE });
+  _percussion = AlgorithmFactory::create("MusicExtractorSVM", "svms",
+                                         vector<string>{ models_directory + MODEL_PERCUSSION_TYPE });
+  _common = AlgorithmFactory::create("MusicExtractorSVM", "svms", models_common);
+}
+
+Extractor::~Extractor() {
+  delete _lowlevel;
+  delete _type;
+  delete _phrase;
+  delete _percussion;
+  delete _common;
+}
+
+bool Extractor::Extract(Pool *pool, const string &file_name, bool compute_highlevel) {
+  std::lock_guard<std::mutex> lock(ExtractionMutex());
+  try {
+    Pool temporary_pool;
+    _lowlevel->input("filename").set(file_name);
+    _lowlevel->output("results").set(*pool);
+    _lowlevel->output("resultsFrames").set(temporary_pool);
+    _lowlevel->compute();
+    if ( compute_highlevel ) {
+      Classify(pool);
+    }
+  }
+  catch (essentia::EssentiaException e) {
+    std::cout << e.what() << std::endl;
+    return false;
+  }
+  return true;
+}
+
+void Extractor::Classify(Pool *pool) {
+  // the same classifiers as ExtractHighLevel(pool, models_directory)
+  auto classify = [pool](Algorithm* svm) {
+    try {
+      svm->input("pool").set(*pool);
+      svm->output("pool").set(*pool);
+      svm->compute();
+    }
+    catch ( essentia::EssentiaException ) {
+    }
+  };
+  pool->removeNamespace("highlevel");
+  classify(_type);
+  switch ( name_to_type[pool->value<string>(TYPE_DESCRIPTOR)] ) {
+  case vocal:
+    classify(_phrase);
+    break;
+  case percussion:
+    classify(_percussion);
+  default:
+    classify(_common);
+    break;
+  }
+}
+
 void SamplesToDataSet(const string &samples_directory,
                       const string &output_directory,
                       const string &profile,
@@ -26,15 +105,25 @@ void SamplesToDataSet(const string &samples_directory,
                       const int samples_per_dataset,
                       const string &datasets_directory,
                       const string &dataset_name) {
-  if ( !essentia::isInitialized() )
-    essentia::init();
+  Extractor extractor(profile, models_directory);
+  SamplesToDataSet(samples_directory, output_directory, &extractor, dataset_part_name, samples_per_dataset,
+                   datasets_directory, dataset_name);
+}
+
+void SamplesToDataSet(const string &samples_directory,
+                      const string &output_directory,
+                      Extractor *extractor,
+                      const string &dataset_part_name,
+                      const int samples_per_dataset,
+                      const string &datasets_directory,
+                      const string &dataset_name) {
   // remove directories with data from previous session
   if ( filesystem::exists(filesystem::path(output_directory)) )
     filesystem::remove_all(output_directory);
 
   filesystem::create_directory(output_directory);
   util::ReCreateDirs(datasets_directory);
-  ProcessSamples(samples_directory, profile, output_directory, models_directory);
+  ProcessSamples(samples_directory, output_directory, extractor);
   util::MergeFiles(output_directory, datasets_directory,
                    dataset_part_name, samples_per_dataset);
   for ( auto t : types::TYPES ) {
@@ -45,37 +134,53 @@ void SamplesToDataSet(const string &samples_directory,
 void ProcessSamples(const string &directory, const string &profile,
                     const string &output_directory, const string &models_directory,
                     bool compute_highlevel) {
-  if ( !essentia::isInitialized() )
-    essentia::init();
-  std::set<string> extensions = { ".wav", ".mp3", ".mp4a", ".ogg", ".aiff" };
+  Extractor extractor(profile, models_directory);
+  ProcessSamples(directory, output_directory, &extractor, compute_highlevel);
+}
+
+void ProcessSamples(const string &directory, const string &output_directory, Extractor *extractor,
+                    bool compute_highlevel) {
   if (!filesystem::exists(filesystem::path(output_directory)))
     filesystem::create_directory(output_directory);
+  for ( const auto &file_name : AudioFiles(directory) ) {
+    std::cout << file_name << std::endl;
+    Pool pool;
+    if ( extractor->Extract(&pool, file_name, compute_highlevel) ) {
+      SavePool(pool, output_directory + pool.value<string>(MD5_DESCRIPTOR) + ".sig");
+    }
+  }
+}
+
+vector<string> AudioFiles(const string &directory) {
+  std::set<string> extensions = { ".wav", ".mp3", ".mp4a", ".ogg", ".aiff" };
+  vector<string> files;
   for ( auto &p : filesystem::recursive_directory_iterator(directory) ) {
-    std::cout << p << std::endl;
-    auto ext = p.path().extension();
-    if ( extensions.find(ext) != extensions.end() ) {
-        Extract(p.path().string(), profile, output_directory, models_directory, compute_highlevel);
+    if ( extensions.find(p.path().extension().string()) != extensions.end() ) {
+      files.push_back(p.path().string());
     }
   }
+  return files;
 }
 
 void Extract(const string &file_name, const string &profile,
              const string &output_directory, const string &models_directory,
              bool compute_highlevel) {
   Pool pool;
-  try {
-    ExtractLowLevel(&pool, file_name, profile);
-    if ( compute_highlevel ) {
-      ExtractHighLevel(&pool, models_directory);
-    }
-  }
-  catch (essentia::EssentiaException e) {
-    std::cout << e.what() << std::endl;
-    return;
+  if ( ExtractPool(&pool, file_name, profile, models_directory, compute_highlevel) ) {
+    SavePool(pool, output_directory + pool.value<string>(MD5_DESCRIPTOR) + ".sig");
   }
+}
+
+bool ExtractPool(Pool *pool, const string &file_name, const string &profile,
+                 const string &models_directory, bool compute_highlevel) {
+  Extractor extractor(profile, models_directory);
+  return extractor.Extract(pool, file_name, compute_highlevel);
+}
+
+void SavePool(const Pool &pool, const string &output_file_name) {
   Algorithm* output = AlgorithmFactory::create("YamlOutput");
   output->input("pool").set(pool);
-  output->configure("filename", output_directory + pool.value<string>(MD5_DESCRIPTOR) + ".sig");
+  output->configure("filename", output_file_name);
   output->compute();
   delete output;
 }
@@ -2,9 +2,11 @@
 #define PROJECT_AUDIQ_PROCESSING_H
 
 #include "audiq/audiq.h"
+#include <mutex>
 #include <string>
 #include <vector>
 #include "essentia/pool.h"
+#include "essentia/algorithm.h"
 #include "audiq/audiq_types.h"
 #include "audiq/audiq_config.h"
 
@@ -12,6 +14,40 @@ namespace audiq {
 namespace processing {
 
 using essentia::Pool;
+
+/**
+ * @brief ExtractionMutex Essentia extraction isn't reentrant, so every extraction of the process takes this lock.
+ */
+std::mutex& ExtractionMutex();
+
+/**
+ * @brief Extractor Resident extractor: AudiqMusicExtractor configured with 'profile' and MusicExtractorSVM
+ * classifiers of all models of 'models_directory' are created once and reused by every Extract.
+ * Extract may be called from several threads, extractions are serialized by ExtractionMutex.
+ */
+class Extractor {
+ public:
+  Extractor(const string &profile, const string &models_directory);
+  ~Extractor();
+
+  Extractor(const Extractor&) = delete;
+  Extractor& operator=(const Extractor&) = delete;
+
+  /**
+   * Extract Extracts descriptors of single sample 'file_name' to 'pool', returns false on failure.
+   */
+  bool Extract(Pool *pool, const string &file_name, bool compute_highlevel = true);
+
+ private:
+  void Classify(Pool *pool);
+
+  essentia::standard::Algorithm* _lowlevel;
+  essentia::standard::Algorithm* _type;
+  essentia::standard::Algorithm* _phrase;
+  essentia::standard::Algorithm* _percussion;
+  essentia::standard::Algorithm* _common;
+};
+
 /**
  * @brief SamplesToDataSet Gets dataset from samples of 'samples_directory'
  * @param samples_directory Directory with samples.
@@ -29,6 +65,16 @@ void SamplesToDataSet(const string &samples_directory,
                       const int samples_per_dataset,
                       const string &datasets_directory,
                       const string &dataset_name);
+/**
+ * @brief SamplesToDataSet Same as above, but samples are extracted with resident 'extractor'.
+ */
+void SamplesToDataSet(const string &samples_directory,
+                      const string &output_directory,
+                      Extractor *extractor,
+                      const string &dataset_part_name,
+                      const int samples_per_dataset,
+                      const string &datasets_directory,
+                      const string &dataset_name);
 /**
  * @brief ProcessSamples Extracts descriptors of samples from 'samples_directory' store them into 'output_directory'
  * @param samples_directory Directory where samples stored
@@ -37,6 +83,16 @@ void SamplesToDataSet(const string &samples_directory,
 void ProcessSamples(const string &samples_directory, const string &profile,
                     const string &output_directory, const string &models_directory,
                     bool compute_highleve = true);
+/**
+ * @brief ProcessSamples Same as above, but samples are extracted with resident 'extractor'.
+ */
+void ProcessSamples(const string &samples_directory, const string &output_directory, Extractor *extractor,
+                    bool compute_highlevel = true);
+
+/**
+ * @brief AudioFiles Returns audio files (see Extract) of 'directory' and its subdirectories.
+ */
+vector<string> AudioFiles(const string &directory);
 
 void ProcessSigsHighLevel(const string &directory, const string &models_directory);
 /**
@@ -50,6 +106,17 @@ void Extract(const string &file_name, const string &profile,
              const string &output_directory, const string &models_directory,
              bool compute_highlevel);
 
+/**
+ * @brief ExtractPool Extracts descriptors of single sample 'file_name' to 'pool', returns false on failure.
+ * @note Extractor is created for this call only, use Extractor to extract many samples.
+ */
+bool ExtractPool(Pool *pool, const string &file_name, const string &profile,
+                 const string &models_directory, bool compute_highlevel = true);
+/**
+ * @brief SavePool Saves descriptors 'pool' as YAML file 'output_file_name' (.sig file).
+ */
+void SavePool(const Pool &pool, const string &output_file_name);
+
 void ExtractLowLevel(Pool *pool, const string &file_name, const string &profile);
 
 void ExtractHighLevel(const string &file_name, const string &models_directory);
@@ -0,0 +1,153 @@
+#include "audiq/audiq_product_quantizer.h"
+#include <limits>
+#include <atomic>
+#include <random>
+#include <thread>
+#include <numeric>
+#include <algorithm>
+#include <functional>
+#include "audiq/audiq_concurrency.h"
+
+namespace audiq {
+namespace similarity {
+
+namespace {
+
+/**
+ * Parallel Runs 'task' for every number of [0, count) on 'threads' threads.
+ */
+void Parallel(int count, int threads, const std::function<void(int)> &task) {
+  std::atomic<int> next(0);
+  auto worker = [&]() {
+    for ( int n = next++; n < count; n = next++ ) {
+      task(n);
+    }
+  };
+  std::vector<std::thread> workers;
+  for ( int t = 1; t < std::min(util::ThreadsNumber(threads), count); ++t ) {
+    workers.emplace_back(worker);
+  }
+  worker();
+  for ( auto &w : workers ) {
+    w.join();
+  }
+}
+
+}  // namespace
+
+ProductQuantizer::ProductQuantizer() : _dimension(0), _subspace(1), _subspaces(0) {}
+
+void ProductQuantizer::Build(const AlignedBlock<float> &block, int subspace, int threads) {
+  _dimension = block.Dimension();
+  _subspace = std::max(1, subspace);
+  _subspaces = (_dimension + _subspace - 1) / _subspace;
+  _centroids.assign(static_cast<size_t>(_subspaces) * PQ_CENTROIDS * _subspace, 0.0);
+  _codes.assign(static_cast<size_t>(block.Rows()) * _subspaces, 0);
+  if ( block.Rows() == 0 || _subspaces == 0 ) {
+    return;
+  }
+  Parallel(_subspaces, threads, [&](int s) { Train(block, s); });
+  const int chunk = 1024;
+  Parallel((block.Rows() + chunk - 1) / chunk, threads, [&](int c) {
+    for ( int i = c * chunk; i < std::min(block.Rows(), (c + 1) * chunk); ++i ) {
+      for ( int s = 0; s < _subspaces; ++s ) {
+        _codes[static_cast<size_t>(i) * _subspaces + s] = Nearest(block.Row(i) + s * _subspace, s);
+      }
+    }
+  });
+}
+
+void ProductQuantizer::Train(const AlignedBlock<float> &block, int s) {
+  const int width = Width(s);
+  // the same sample for every subspace, so codes of a row are trained on the same data
+  std::vector<int> sample(block.Rows());
+  std::iota(sample.begin(), sample.end(), 0);
+  std::mt19937 random(0);
+  std::shuffle(sample.begin(), sample.end(), random);
+  sample.resize(std::min<size_t>(sample.size(), PQ_TRAINING_ROWS));
+  auto x = [&](int n) { return block.Row(sample[n]) + s * _subspace; };
+  // initial centroids are distinct sample rows, repeated if there are less rows than centroids
+  for ( int c = 0; c < PQ_CENTROIDS; ++c ) {
+    std::copy(x(c % sample.size()), x(c % sample.size()) + width,
+              &_centroids[(static_cast<size_t>(s) * PQ_CENTROIDS + c) * _subspace]);
+  }
+  std::vector<uint8_t> assignment(sample.size());
+  std::vector<double> sums(PQ_CENTROIDS * width);
+  std::vector<int> counts(PQ_CENTROIDS);
+  for ( int iteration = 0; iteration < PQ_ITERATIONS; ++iteration ) {
+    for ( size_t n = 0; n < sample.size(); ++n ) {
+      assignment[n] = Nearest(x(n), s);
+    }
+    std::fill(sums.begin(), sums.end(), 0.0);
+    std::fill(counts.begin(), counts.end(), 0);
+    for ( size_t n = 0; n < sample.size(); ++n ) {
+      ++counts[assignment[n]];
+      for ( int d = 0; d < width; ++d ) {
+        sums[assignment[n] * width + d] += x(n)[d];
+      }
+    }
+    for ( int c = 0; c < PQ_CENTROIDS; ++c ) {
+      // centroid without points keeps its position
+      if ( counts[c] == 0 ) {
+        continue;
+      }
+      float* centroid = &_centroids[(static_cast<size_t>(s) * PQ_CENTROIDS + c) * _subspace];
+      for ( int d = 0; d < width; ++d ) {
+        centroid[d] = sums[c * width + d] / counts[c];
+      }
+    }
+  }
+}
+
+uint8_t ProductQuantizer::Nearest(const float *x, int s) const {
+  const int width = Width(s);
+  float best = std::numeric_limits<float>::infinity();
+  int nearest = 0;
+  for ( int c = 0; c < PQ_CENTROIDS; ++c ) {
+    const float* centroid = Centroid(s, c);
+    float distance = 0.0;
+    for ( int d = 0; d < width; ++d ) {
+      float diff = x[d] - centroid[d];
+      distance += diff * diff;
+    }
+    if ( distance < best ) {
+      best = distance;
+      nearest = c;
+    }
+  }
+  return static_cast<uint8_t>(nearest);
+}
+
+void ProductQuantizer::Table(const float *query, bool inner_product, float *table) const {
+  for ( int s = 0; s < _subspaces; ++s ) {
+    const int width = Width(s);
+    const float* x = query + s * _subspace;
+    for ( int c = 0; c < PQ_CENTROIDS; ++c ) {
+      const float* centroid = Centroid(s, c);
+      float value = 0.0;
+      for ( int d = 0; d < width; ++d ) {
+        if ( inner_product ) {
+          value += x[d] * centroid[d];
+        } else {
+          float diff = x[d] - centroid[d];
+          value += diff * diff;
+        }
+      }
+      table[s * PQ_CENTROIDS + c] = value;
+    }
+  }
+}
+
+void ProductQuantizer::Decode(int i, float *row) const {
+  for ( int s = 0; s < _subspaces; ++s ) {
+    const float* centroid = Centroid(s, _codes[static_cast<size_t>(i) * _subspaces + s]);
+    std::copy(centroid, centroid + Width(s), row + s * _subspace);
+  }
+}
+
+size_t ProductQuantizer::Bytes() const {
+  return _codes.size() + _centroids.size() * sizeof(float);
+}
+
+}  // namespace similarity
+}  // namespace audiq
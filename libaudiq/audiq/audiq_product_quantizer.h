@@ -0,0 +1,79 @@
+#ifndef PROJECT_AUDIQ_PRODUCT_QUANTIZER_H
+#define PROJECT_AUDIQ_PRODUCT_QUANTIZER_H
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include "audiq/audiq_aligned_block.h"
+
+// number of centroids of every subspace, codes are bytes
+#define PQ_CENTROIDS     256
+// k-means of every subspace is trained on at most this number of rows
+#define PQ_TRAINING_ROWS 10240
+#define PQ_ITERATIONS    10
+// dimensions of one subspace of quantized blocks
+#define PQ_SUBSPACE      4
+
+namespace audiq {
+namespace similarity {
+
+/**
+ * @brief ProductQuantizer Product quantization of a feature store block: dimensions are split into
+ * subspaces of 'subspace' dimensions, every subspace of a row is replaced by the byte code of the nearest of
+ * PQ_CENTROIDS k-means centroids. Distances to a query are computed asymmetrically: query stays float,
+ * squared distances or inner products of its subvectors and all centroids are tabulated once (Table)
+ * and a row costs one lookup per subspace (Lookup).
+ */
+class ProductQuantizer {
+ public:
+  ProductQuantizer();
+
+  /**
+   * Build Trains codebooks on a sample of rows of 'block' and encodes all rows on 'threads' threads
+   * (0 - number of hardware threads).
+   */
+  void Build(const AlignedBlock<float> &block, int subspace, int threads = 0);
+  /**
+   * Table Fills ADC table of 'query' ('Dimension()' values): Subspaces() x PQ_CENTROIDS
+   * squared distances between query subvectors and centroids, or inner products if 'inner_product' is set.
+   */
+  void Table(const float *query, bool inner_product, float *table) const;
+  /**
+   * Lookup Sum of 'table' values of codes of row 'i'.
+   */
+  float Lookup(int i, const float *table) const {
+    const uint8_t* codes = _codes.data() + static_cast<size_t>(i) * _subspaces;
+    float sum = 0.0;
+    for ( int s = 0; s < _subspaces; ++s, table += PQ_CENTROIDS ) {
+      sum += table[codes[s]];
+    }
+    return sum;
+  }
+  /**
+   * Decode Restores approximate row 'i' to 'row' ('Dimension()' values).
+   */
+  void Decode(int i, float *row) const;
+
+  int Dimension() const { return _dimension; }
+  int Subspaces() const { return _subspaces; }
+  int TableSize() const { return _subspaces * PQ_CENTROIDS; }
+  size_t Bytes() const;
+
+ private:
+  int Width(int s) const { return std::min(_subspace, _dimension - s * _subspace); }
+  const float* Centroid(int s, int c) const { return &_centroids[(static_cast<size_t>(s) * PQ_CENTROIDS + c) * _subspace]; }
+  void Train(const AlignedBlock<float> &block, int s);
+  uint8_t Nearest(const float *x, int s) const;
+
+  int _dimension;
+  int _subspace;
+  int _subspaces;
+  // _centroids[(s * PQ_CENTROIDS + c) * _subspace + d] - dimension 'd' of centroid 'c' of subspace 's'
+  std::vector<float> _centroids;
+  // _codes[i * _subspaces + s] - code of subspace 's' of row 'i'
+  std::vector<uint8_t> _codes;
+};
+
+}  // namespace similarity
+}  // namespace audiq
+#endif  // PROJECT_AUDIQ_PRODUCT_QUANTIZER_H
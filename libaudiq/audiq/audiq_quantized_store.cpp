@@ -0,0 +1,288 @@
+#include "audiq/audiq_quantized_store.h"
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+namespace audiq {
+namespace similarity {
+
+namespace {
+
+uint16_t FloatToHalf(float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  uint16_t sign = (bits >> 16) & 0x8000;
+  int exponent = static_cast<int>((bits >> 23) & 0xff) - 127 + 15;
+  uint32_t mantissa = bits & 0x7fffff;
+  if ( exponent <= 0 ) {
+    // values are normalized to [0, 1], so subnormals are rounded to zero
+    return sign;
+  }
+  if ( exponent >= 31 ) {
+    return sign | 0x7bff;
+  }
+  uint16_t half = sign | (exponent << 10) | (mantissa >> 13);
+  // round to nearest
+  if ( mantissa & 0x1000 ) {
+    ++half;
+  }
+  return half;
+}
+
+float HalfToFloat(uint16_t half) {
+  uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+  uint32_t exponent = (half >> 10) & 0x1f;
+  uint32_t mantissa = half & 0x3ff;
+  uint32_t bits = sign;
+  if ( exponent != 0 ) {
+    bits |= ((exponent - 15 + 127) << 23) | (mantissa << 13);
+  }
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+}  // namespace
+
+Quantization QuantizationFromString(const std::string &name) {
+  if ( name == "fp16" ) {
+    return QUANTIZATION_FP16;
+  }
+  if ( name == "int8" ) {
+    return QUANTIZATION_INT8;
+  }
+  if ( name == "pq" ) {
+    return QUANTIZATION_PQ;
+  }
+  return QUANTIZATION_NONE;
+}
+
+QuantizedBlock::QuantizedBlock() : _mode(QUANTIZATION_NONE), _dimension(0) {}
+
+void QuantizedBlock::Quantize(const AlignedBlock<float> &block, Quantization mode) {
+  _mode = mode;
+  _dimension = block.Dimension();
+  const int rows = block.Rows();
+  _scale.assign(_dimension, 1.0);
+  _offset.assign(_dimension, 0.0);
+  for ( int d = 0; d < _dimension && rows > 0; ++d ) {
+    float minimum = block.Row(0)[d];
+    float maximum = minimum;
+    for ( int i = 1; i < rows; ++i ) {
+      minimum = std::min(minimum, block.Row(i)[d]);
+      maximum = std::max(maximum, block.Row(i)[d]);
+    }
+    _offset[d] = minimum;
+    if ( maximum > minimum ) {
+      _scale[d] = (maximum - minimum) / (mode == QUANTIZATION_INT8 ? 255.0f : 1.0f);
+    }
+  }
+  const size_t size = static_cast<size_t>(rows) * _dimension;
+  _halfs.clear();
+  _bytes.clear();
+  if ( mode == QUANTIZATION_INT8 ) {
+    _bytes.resize(size);
+  } else {
+    _halfs.resize(size);
+  }
+  for ( int i = 0; i < rows; ++i ) {
+    const float* row = block.Row(i);
+    for ( int d = 0; d < _dimension; ++d ) {
+      float code = (row[d] - _offset[d]) / _scale[d];
+      size_t position = static_cast<size_t>(i) * _dimension + d;
+      if ( mode == QUANTIZATION_INT8 ) {
+        _bytes[position] = static_cast<uint8_t>(std::min(255.0f, std::max(0.0f, std::round(code))));
+      } else {
+        _halfs[position] = FloatToHalf(code);
+      }
+    }
+  }
+}
+
+float QuantizedBlock::Code(size_t position) const {
+  if ( _mode == QUANTIZATION_INT8 ) {
+    return _bytes[position];
+  }
+  return HalfToFloat(_halfs[position]);
+}
+
+void QuantizedBlock::Decode(int i, float *row) const {
+  const size_t begin = static_cast<size_t>(i) * _dimension;
+  for ( int d = 0; d < _dimension; ++d ) {
+    row[d] = _offset[d] + _scale[d] * Code(begin + d);
+  }
+}
+
+void QuantizedBlock::Shift(const float *query, float *shifted) const {
+  for ( int d = 0; d < _dimension; ++d ) {
+    shifted[d] = query[d] - _offset[d];
+  }
+}
+
+float QuantizedBlock::SquaredDistance(int i, const float *shifted) const {
+  const size_t begin = static_cast<size_t>(i) * _dimension;
+  float sum = 0.0;
+  for ( int d = 0; d < _dimension; ++d ) {
+    float diff = shifted[d] - _scale[d] * Code(begin + d);
+    sum += diff * diff;
+  }
+  return sum;
+}
+
+float QuantizedBlock::Scale(const float *query, float *scaled) const {
+  float base = 0.0;
+  for ( int d = 0; d < _dimension; ++d ) {
+    scaled[d] = query[d] * _scale[d];
+    base += query[d] * _offset[d];
+  }
+  return base;
+}
+
+float QuantizedBlock::Dot(int i, const float *scaled, float base) const {
+  const size_t begin = static_cast<size_t>(i) * _dimension;
+  float sum = base;
+  for ( int d = 0; d < _dimension; ++d ) {
+    sum += scaled[d] * Code(begin + d);
+  }
+  return sum;
+}
+
+size_t QuantizedBlock::Bytes() const {
+  return _bytes.size() + _halfs.size() * sizeof(uint16_t)
+       + (_scale.size() + _offset.size()) * sizeof(float);
+}
+
+QuantizedStore::QuantizedStore(const FeatureStore &store, Quantization mode, int threads)
+    : _size(store.Size()), _mode(mode), _file_names(store.Size()) {
+  if ( mode == QUANTIZATION_PQ ) {
+    _product_pca.Build(store.Pca(), PQ_SUBSPACE, threads);
+    _product_mfcc_icov_terms.Build(store.MfccIcovTerms(), PQ_SUBSPACE, threads);
+    _product_mfcc_cov_terms.Build(store.MfccCovTerms(), PQ_SUBSPACE, threads);
+    _product_highlevel.Build(store.Highlevel(), PQ_SUBSPACE, threads);
+    _highlevel_sums.resize(_size);
+    _highlevel_squares.resize(_size);
+    for ( int i = 0; i < _size; ++i ) {
+      const float* row = store.Highlevel().Row(i);
+      for ( int d = 0; d < store.Highlevel().Dimension(); ++d ) {
+        _highlevel_sums[i] += row[d];
+        _highlevel_squares[i] += row[d] * row[d];
+      }
+    }
+  } else {
+    _pca.Quantize(store.Pca(), mode);
+    _mfcc_icov_terms.Quantize(store.MfccIcovTerms(), mode);
+    _mfcc_cov_terms.Quantize(store.MfccCovTerms(), mode);
+    _highlevel.Quantize(store.Highlevel(), mode);
+  }
+  for ( int i = 0; i < _size; ++i ) {
+    _file_names[i] = store.FileName(i);
+  }
+}
+
+size_t QuantizedStore::Bytes() const {
+  return _pca.Bytes() + _mfcc_icov_terms.Bytes() + _mfcc_cov_terms.Bytes() + _highlevel.Bytes()
+       + _product_pca.Bytes() + _product_mfcc_icov_terms.Bytes() + _product_mfcc_cov_terms.Bytes()
+       + _product_highlevel.Bytes()
+       + (_highlevel_sums.size() + _highlevel_squares.size()) * sizeof(float);
+}
+
+namespace {
+
+/**
+ * ProductSearch QuantizedSearch on product quantization codes: squared pca distances and inner products
+ * of mfcc terms and highlevel probabilities of the query and all centroids are tabulated once,
+ * then every component of a row is the sum of table values of its codes.
+ */
+std::vector<Neighbour> ProductSearch(const QuantizedStore &catalog, const FeatureStore &queries,
+                                     int query, int k, const MetricWeights &weights,
+                                     const std::vector<bool> &exclude) {
+  const ProductQuantizer &pca = catalog.ProductPca();
+  const ProductQuantizer &icov_terms = catalog.ProductMfccIcovTerms();
+  const ProductQuantizer &cov_terms = catalog.ProductMfccCovTerms();
+  const ProductQuantizer &highlevel = catalog.ProductHighlevel();
+  std::vector<float> pca_table(pca.TableSize());
+  std::vector<float> icov_table(icov_terms.TableSize());
+  std::vector<float> cov_table(cov_terms.TableSize());
+  std::vector<float> highlevel_table(highlevel.TableSize());
+  pca.Table(queries.Pca().Row(query), false, pca_table.data());
+  // dot(icov_terms[row], cov_terms[query]) + dot(icov_terms[query], cov_terms[row]), see FeatureStore
+  icov_terms.Table(queries.MfccCovTerms().Row(query), true, icov_table.data());
+  cov_terms.Table(queries.MfccIcovTerms().Row(query), true, cov_table.data());
+  highlevel.Table(queries.Highlevel().Row(query), true, highlevel_table.data());
+  const int dimension = highlevel.Dimension();
+  Moments m = { 0.0, 0.0, 0.0, 0.0, 0.0 };
+  const float* query_highlevel = queries.Highlevel().Row(query);
+  for ( int d = 0; d < dimension; ++d ) {
+    m.a += query_highlevel[d];
+    m.aa += query_highlevel[d] * query_highlevel[d];
+  }
+  TopK top(k);
+  for ( int i = 0; i < catalog.Size(); ++i ) {
+    if ( !exclude.empty() && exclude[i] ) {
+      continue;
+    }
+    float distance = weights.pca * Compress(std::sqrt(std::max(0.0f, pca.Lookup(i, pca_table.data()))));
+    if ( top.Full() && distance >= top.Worst() ) {
+      continue;
+    }
+    if ( dimension > 0 ) {
+      m.ab = highlevel.Lookup(i, highlevel_table.data());
+      m.b = catalog.HighlevelSum(i);
+      m.bb = catalog.HighlevelSquares(i);
+      distance += weights.highlevel * Compress(PearsonDistance(m, dimension));
+      if ( top.Full() && distance >= top.Worst() ) {
+        continue;
+      }
+    }
+    float mfcc = 0.5f * (icov_terms.Lookup(i, icov_table.data()) + cov_terms.Lookup(i, cov_table.data()));
+    distance += weights.mfcc * Compress(std::max(0.0f, mfcc - MFCC_DIMENSION));
+    top.Push(i, distance);
+  }
+  return top.Sorted();
+}
+
+}  // namespace
+
+std::vector<Neighbour> QuantizedSearch(const QuantizedStore &catalog, const FeatureStore &queries,
+                                       int query, int k, const MetricWeights &weights,
+                                       const std::vector<bool> &exclude) {
+  if ( k <= 0 ) {
+    return std::vector<Neighbour>();
+  }
+  if ( catalog.Mode() == QUANTIZATION_PQ ) {
+    return ProductSearch(catalog, queries, query, k, weights, exclude);
+  }
+  std::vector<float> pca(catalog.Pca().Dimension());
+  AlignedBlock<float> highlevel(1, catalog.Highlevel().Dimension());
+  catalog.Pca().Shift(queries.Pca().Row(query), pca.data());
+  const float* query_highlevel = queries.Highlevel().Row(query);
+  // dot(icov_terms[row], cov_terms[query]) + dot(icov_terms[query], cov_terms[row]), see FeatureStore
+  std::vector<float> icov_terms(MFCC_TERMS);
+  std::vector<float> cov_terms(MFCC_TERMS);
+  const float icov_base = catalog.MfccIcovTerms().Scale(queries.MfccCovTerms().Row(query), icov_terms.data());
+  const float cov_base = catalog.MfccCovTerms().Scale(queries.MfccIcovTerms().Row(query), cov_terms.data());
+  TopK top(k);
+  for ( int i = 0; i < catalog.Size(); ++i ) {
+    if ( !exclude.empty() && exclude[i] ) {
+      continue;
+    }
+    float distance = weights.pca * Compress(std::sqrt(catalog.Pca().SquaredDistance(i, pca.data())));
+    if ( top.Full() && distance >= top.Worst() ) {
+      continue;
+    }
+    catalog.Highlevel().Decode(i, highlevel.Row(0));
+    distance += weights.highlevel * Compress(HighlevelDistance(highlevel.Row(0), query_highlevel,
+                                                               highlevel.Dimension()));
+    if ( top.Full() && distance >= top.Worst() ) {
+      continue;
+    }
+    float mfcc = 0.5f * (catalog.MfccIcovTerms().Dot(i, icov_terms.data(), icov_base)
+                         + catalog.MfccCovTerms().Dot(i, cov_terms.data(), cov_base));
+    distance += weights.mfcc * Compress(std::max(0.0f, mfcc - MFCC_DIMENSION));
+    top.Push(i, distance);
+  }
+  return top.Sorted();
+}
+
+}  // namespace similarity
+}  // namespace audiq
@@ -0,0 +1,112 @@
+#ifndef PROJECT_AUDIQ_QUANTIZED_STORE_H
+#define PROJECT_AUDIQ_QUANTIZED_STORE_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "audiq/audiq_search.h"
+#include "audiq/audiq_feature_store.h"
+#include "audiq/audiq_product_quantizer.h"
+#include "audiq/audiq_search_options.h"
+
+namespace audiq {
+namespace similarity {
+
+/**
+ * @brief QuantizedBlock Densely packed fp16 or int8 copy of a feature store block.
+ * Value of dimension 'd' is restored as offset[d] + scale[d] * code, where code is
+ * the stored half float or unsigned byte.
+ */
+class QuantizedBlock {
+ public:
+  QuantizedBlock();
+  void Quantize(const AlignedBlock<float> &block, Quantization mode);
+  /**
+   * Decode Restores row 'i' to 'row' ('Dimension()' values).
+   */
+  void Decode(int i, float *row) const;
+  /**
+   * SquaredDistance Squared Euclidean distance between row 'i' and 'shifted' - query with subtracted offsets.
+   */
+  float SquaredDistance(int i, const float *shifted) const;
+  void Shift(const float *query, float *shifted) const;
+  /**
+   * Dot Dot product of row 'i' and query, where 'scaled' is query multiplied by scales and 'base' is
+   * dot product of query and offsets (see Scale).
+   */
+  float Dot(int i, const float *scaled, float base) const;
+  /**
+   * Scale Writes 'query' multiplied by scales to 'scaled' and returns dot product of 'query' and offsets.
+   */
+  float Scale(const float *query, float *scaled) const;
+
+  int Dimension() const { return _dimension; }
+  size_t Bytes() const;
+
+ private:
+  float Code(size_t position) const;
+
+  Quantization _mode;
+  int _dimension;
+  std::vector<uint16_t> _halfs;
+  std::vector<uint8_t> _bytes;
+  std::vector<float> _scale;
+  std::vector<float> _offset;
+};
+
+/**
+ * @brief QuantizedStore Quantized blocks (pca, mfcc terms and highlevel) of feature store together with filename
+ * table. In QUANTIZATION_PQ mode blocks are product quantized with PQ_SUBSPACE dimensions per byte code,
+ * and exact sum and sum of squares of highlevel rows are kept for Pearson distance.
+ */
+class QuantizedStore {
+ public:
+  /**
+   * @param threads Number of threads training product quantizers (0 - number of hardware threads).
+   */
+  QuantizedStore(const FeatureStore &store, Quantization mode, int threads = 0);
+
+  int Size() const { return _size; }
+  Quantization Mode() const { return _mode; }
+  const QuantizedBlock& Pca() const { return _pca; }
+  const QuantizedBlock& MfccIcovTerms() const { return _mfcc_icov_terms; }
+  const QuantizedBlock& MfccCovTerms() const { return _mfcc_cov_terms; }
+  const QuantizedBlock& Highlevel() const { return _highlevel; }
+  const ProductQuantizer& ProductPca() const { return _product_pca; }
+  const ProductQuantizer& ProductMfccIcovTerms() const { return _product_mfcc_icov_terms; }
+  const ProductQuantizer& ProductMfccCovTerms() const { return _product_mfcc_cov_terms; }
+  const ProductQuantizer& ProductHighlevel() const { return _product_highlevel; }
+  float HighlevelSum(int i) const { return _highlevel_sums[i]; }
+  float HighlevelSquares(int i) const { return _highlevel_squares[i]; }
+  const std::string& FileName(int i) const { return _file_names[i]; }
+  size_t Bytes() const;
+
+ private:
+  int _size;
+  Quantization _mode;
+  QuantizedBlock _pca;
+  QuantizedBlock _mfcc_icov_terms;
+  QuantizedBlock _mfcc_cov_terms;
+  QuantizedBlock _highlevel;
+  ProductQuantizer _product_pca;
+  ProductQuantizer _product_mfcc_icov_terms;
+  ProductQuantizer _product_mfcc_cov_terms;
+  ProductQuantizer _product_highlevel;
+  std::vector<float> _highlevel_sums;
+  std::vector<float> _highlevel_squares;
+  std::vector<std::string> _file_names;
+};
+
+/**
+ * @brief QuantizedSearch Search of 'k' the most similar to 'queries[query]' points directly on quantized data.
+ * Approximate distance combines all components computed on quantized rows (with lookup tables of the query
+ * in QUANTIZATION_PQ mode), use Rerank for exact order.
+ * @param exclude Rows of catalog which mustn't be returned (may be empty).
+ */
+std::vector<Neighbour> QuantizedSearch(const QuantizedStore &catalog, const FeatureStore &queries,
+                                       int query, int k, const MetricWeights &weights,
+                                       const std::vector<bool> &exclude = std::vector<bool>());
+
+}  // namespace similarity
+}  // namespace audiq
+#endif  // PROJECT_AUDIQ_QUANTIZED_STORE_H
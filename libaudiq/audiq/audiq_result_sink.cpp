@@ -0,0 +1,223 @@
+#include "audiq/audiq_result_sink.h"
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include "yaml.h"
+#include "audiq/audiq_binary_io.h"
+
+namespace audiq {
+
+using similarity::Recommendation;
+
+namespace {
+
+/**
+ * YamlSink Emits YAML events of every target with libyaml, the document is never built in memory.
+ */
+class YamlSink : public ResultSink {
+ public:
+  explicit YamlSink(FILE *output) : _output(output) {
+    yaml_emitter_initialize(&_emitter);
+    yaml_emitter_set_output_file(&_emitter, _output);
+    yaml_event_t event;
+    yaml_stream_start_event_initialize(&event, YAML_UTF8_ENCODING);
+    yaml_emitter_emit(&_emitter, &event);
+    yaml_document_start_event_initialize(&event, NULL, NULL, NULL, 0);
+    yaml_emitter_emit(&_emitter, &event);
+    yaml_sequence_start_event_initialize(&event, NULL, NULL, 1, YAML_BLOCK_SEQUENCE_STYLE);
+    yaml_emitter_emit(&_emitter, &event);
+  }
+
+  ~YamlSink() {
+    yaml_event_t event;
+    yaml_sequence_end_event_initialize(&event);
+    yaml_emitter_emit(&_emitter, &event);
+    yaml_document_end_event_initialize(&event, 1);
+    yaml_emitter_emit(&_emitter, &event);
+    yaml_stream_end_event_initialize(&event);
+    yaml_emitter_emit(&_emitter, &event);
+    yaml_emitter_delete(&_emitter);
+    fclose(_output);
+  }
+
+ private:
+  void Emit(const std::string &target, const std::vector<Recommendation> &similar) override {
+    yaml_event_t event;
+    yaml_mapping_start_event_initialize(&event, NULL, NULL, 1, YAML_BLOCK_MAPPING_STYLE);
+    yaml_emitter_emit(&_emitter, &event);
+    Scalar(target, YAML_DOUBLE_QUOTED_SCALAR_STYLE);
+    yaml_sequence_start_event_initialize(&event, NULL, NULL, 1, YAML_BLOCK_SEQUENCE_STYLE);
+    yaml_emitter_emit(&_emitter, &event);
+    for ( const auto &r : similar ) {
+      yaml_mapping_start_event_initialize(&event, NULL, NULL, 1, YAML_BLOCK_MAPPING_STYLE);
+      yaml_emitter_emit(&_emitter, &event);
+      Scalar("sample", YAML_PLAIN_SCALAR_STYLE);
+      Scalar(r.file_name, YAML_DOUBLE_QUOTED_SCALAR_STYLE);
+      Number("distance", r.distance);
+      Number("pca", r.components.pca);
+      Number("mfcc", r.components.mfcc);
+      Number("highlevel", r.components.highlevel);
+      yaml_mapping_end_event_initialize(&event);
+      yaml_emitter_emit(&_emitter, &event);
+    }
+    yaml_sequence_end_event_initialize(&event);
+    yaml_emitter_emit(&_emitter, &event);
+    yaml_mapping_end_event_initialize(&event);
+    yaml_emitter_emit(&_emitter, &event);
+    yaml_emitter_flush(&_emitter);
+  }
+
+  void Scalar(const std::string &value, yaml_scalar_style_t style) {
+    yaml_event_t event;
+    yaml_scalar_event_initialize(&event, NULL, NULL,
+                                 reinterpret_cast<yaml_char_t*>(const_cast<char*>(value.c_str())),
+                                 value.size(), 1, 1, style);
+    yaml_emitter_emit(&_emitter, &event);
+  }
+
+  void Number(const std::string &key, float value) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%g", value);
+    Scalar(key, YAML_PLAIN_SCALAR_STYLE);
+    Scalar(buffer, YAML_PLAIN_SCALAR_STYLE);
+  }
+
+  FILE* _output;
+  yaml_emitter_t _emitter;
+};
+
+/**
+ * JsonString Returns 'value' as quoted JSON string.
+ */
+std::string JsonString(const std::string &value) {
+  std::string json = "\"";
+  for ( char c : value ) {
+    if ( c == '"' || c == '\\' ) {
+      json += '\\';
+      json += c;
+    } else if ( static_cast<unsigned char>(c) < 0x20 ) {
+      char buffer[8];
+      std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+      json += buffer;
+    } else {
+      json += c;
+    }
+  }
+  return json + "\"";
+}
+
+/**
+ * JsonNumber Returns 'value' as JSON number, null if it isn't finite.
+ */
+std::string JsonNumber(float value) {
+  if ( !std::isfinite(value) ) {
+    return "null";
+  }
+  char buffer[32];
+  std::snprintf(buffer, sizeof(buffer), "%g", value);
+  return buffer;
+}
+
+class JsonLinesSink : public ResultSink {
+ public:
+  explicit JsonLinesSink(const std::string &file_name) : _output(file_name) {}
+  bool Good() const { return static_cast<bool>(_output); }
+
+ private:
+  void Emit(const std::string &target, const std::vector<Recommendation> &similar) override {
+    _output << "{\"target\": " << JsonString(target) << ", \"similar\": [";
+    for ( size_t i = 0; i < similar.size(); ++i ) {
+      const Recommendation &r = similar[i];
+      _output << (i > 0 ? ", " : "") << "{\"sample\": " << JsonString(r.file_name)
+              << ", \"distance\": " << JsonNumber(r.distance) << ", \"pca\": " << JsonNumber(r.components.pca)
+              << ", \"mfcc\": " << JsonNumber(r.components.mfcc)
+              << ", \"highlevel\": " << JsonNumber(r.components.highlevel) << "}";
+    }
+    _output << "]}" << std::endl;
+  }
+
+  std::ofstream _output;
+};
+
+class BinarySink : public ResultSink {
+ public:
+  explicit BinarySink(const std::string &file_name) : _output(file_name, std::ios::binary) {
+    util::WriteHeader(_output, RESULT_MAGIC, RESULT_VERSION);
+  }
+  bool Good() const { return static_cast<bool>(_output); }
+
+ private:
+  void Emit(const std::string &target, const std::vector<Recommendation> &similar) override {
+    util::WriteString(_output, target);
+    util::WriteValue<uint32_t>(_output, similar.size());
+    for ( const auto &r : similar ) {
+      util::WriteString(_output, r.file_name);
+      util::WriteValue(_output, r.distance);
+      util::WriteValue(_output, r.components.pca);
+      util::WriteValue(_output, r.components.mfcc);
+      util::WriteValue(_output, r.components.highlevel);
+    }
+    _output.flush();
+  }
+
+  std::ofstream _output;
+};
+
+}  // namespace
+
+void ResultSink::Write(const std::string &target, const std::vector<Recommendation> &similar) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  Emit(target, similar);
+}
+
+similarity::RecommendationHandler ResultSink::Handler() {
+  return [this](const std::string &target, const std::vector<Recommendation> &similar) {
+    Write(target, similar);
+  };
+}
+
+bool IsResultFormat(const std::string &format) {
+  return format == "yaml" || format == "jsonl" || format == "binary";
+}
+
+ResultSink* CreateResultSink(const std::string &format, const std::string &file_name) {
+  if ( format == "yaml" ) {
+    FILE* output = fopen(file_name.c_str(), "wb");
+    return output ? new YamlSink(output) : nullptr;
+  }
+  if ( format == "jsonl" ) {
+    JsonLinesSink* sink = new JsonLinesSink(file_name);
+    if ( sink->Good() ) {
+      return sink;
+    }
+    delete sink;
+  }
+  if ( format == "binary" ) {
+    BinarySink* sink = new BinarySink(file_name);
+    if ( sink->Good() ) {
+      return sink;
+    }
+    delete sink;
+  }
+  return nullptr;
+}
+
+bool ReadResultRecord(std::istream &in, std::string *target, std::vector<Recommendation> *similar) {
+  uint32_t size;
+  // every recommendation takes at least its string size and 4 floats
+  if ( !util::ReadString(in, target) || !util::ReadValue(in, &size)
+       || !util::FitsStream(in, static_cast<uint64_t>(size) * (sizeof(uint32_t) + 4 * sizeof(float))) ) {
+    return false;
+  }
+  similar->resize(size);
+  for ( auto &r : *similar ) {
+    if ( !util::ReadString(in, &r.file_name) || !util::ReadValue(in, &r.distance)
+         || !util::ReadValue(in, &r.components.pca) || !util::ReadValue(in, &r.components.mfcc)
+         || !util::ReadValue(in, &r.components.highlevel) ) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace audiq
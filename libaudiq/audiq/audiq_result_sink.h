@@ -0,0 +1,60 @@
+#ifndef PROJECT_AUDIQ_RESULT_SINK_H
+#define PROJECT_AUDIQ_RESULT_SINK_H
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include <istream>
+#include "audiq/audiq_similarity_model.h"
+
+#define RESULT_MAGIC   "AQRS"
+#define RESULT_VERSION 1
+
+namespace audiq {
+
+/**
+ * @brief ResultSink Writes recommendations of every target sample as soon as they are found
+ * (see similarity::StreamSimilar), instead of building the whole result first. Formats:
+ *  - "yaml"    YAML sequence of { target: [ { sample, distance, pca, mfcc, highlevel }, ... ] } mappings,
+ *              emitted event by event;
+ *  - "jsonl"   one JSON object { "target", "similar": [ { "sample", "distance", "pca", "mfcc", "highlevel" } ] }
+ *              per line;
+ *  - "binary"  RESULT_MAGIC header and records read by ReadResultRecord.
+ * Distance components are compressed distances of similarity::CompressedDefaultMetric.
+ * Write may be called from several threads, output is flushed after every target.
+ */
+class ResultSink {
+ public:
+  virtual ~ResultSink() {}
+  void Write(const std::string &target, const std::vector<similarity::Recommendation> &similar);
+  /**
+   * Handler Returns handler of similarity::StreamSimilar writing to this sink.
+   */
+  similarity::RecommendationHandler Handler();
+
+ private:
+  virtual void Emit(const std::string &target, const std::vector<similarity::Recommendation> &similar) = 0;
+
+  std::mutex _mutex;
+};
+
+/**
+ * @brief CreateResultSink Creates sink of 'format' writing to 'file_name',
+ * returns nullptr if format is unknown or file can't be opened.
+ */
+ResultSink* CreateResultSink(const std::string &format, const std::string &file_name);
+
+/**
+ * @brief IsResultFormat Returns true if 'format' is one of ResultSink formats.
+ */
+bool IsResultFormat(const std::string &format);
+
+/**
+ * @brief ReadResultRecord Reads next target and its recommendations of "binary" result,
+ * header must be read before with util::ReadHeader(in, RESULT_MAGIC, RESULT_VERSION).
+ * @return false at the end of stream or on malformed record.
+ */
+bool ReadResultRecord(std::istream &in, std::string *target, std::vector<similarity::Recommendation> *similar);
+
+}  // namespace audiq
+#endif  // PROJECT_AUDIQ_RESULT_SINK_H
@@ -0,0 +1,207 @@
+#include "audiq/audiq_search.h"
+#include <atomic>
+#include <limits>
+#include <thread>
+#include <algorithm>
+#include <unordered_set>
+#include "audiq/audiq_concurrency.h"
+
+namespace audiq {
+namespace similarity {
+
+namespace {
+
+/**
+ * Prunable Returns true if all 'weights' are non-negative, then weighted sum of some components
+ * is a lower bound of distance.
+ */
+bool Prunable(const std::vector<MetricWeights> &weights) {
+  for ( const auto &w : weights ) {
+    if ( w.pca < 0.0 || w.mfcc < 0.0 || w.highlevel < 0.0 ) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Exceeds Returns true if lower 'bound' of distance exceeds the k-th distance of 'top',
+ * so the point can't get into it.
+ */
+inline bool Exceeds(float bound, const TopK &top) {
+  return bound > top.Worst() * (1.0f + PRUNING_SLACK);
+}
+
+/**
+ * PushPruned Pushes point 'i' of 'catalog' to heaps 'top' of every of 'sets' 'weights'.
+ * Components are computed from the cheapest one (pca, highlevel, mfcc) and the point is dropped
+ * as soon as weighted sum of computed ones exceeds the k-th distance of every heap: the rest
+ * of components are non-negative, so the result is the same as without pruning.
+ */
+void PushPruned(const FeatureStore &catalog, int i, const FeatureStore &queries, int query,
+                const MetricWeights *weights, int sets, bool prune, TopK *top) {
+  Components c;
+  c.pca = Compress(PcaDistance(catalog.Pca().Row(i), queries.Pca().Row(query)));
+  bool needed = !prune;
+  for ( int w = 0; w < sets && !needed; ++w ) {
+    needed = !Exceeds(weights[w].pca * c.pca, top[w]);
+  }
+  if ( !needed ) {
+    return;
+  }
+  c.highlevel = Compress(HighlevelDistance(catalog.Highlevel().Row(i), queries.Highlevel().Row(query),
+                                           catalog.Highlevel().Dimension()));
+  for ( int w = 0; w < sets && !needed; ++w ) {
+    needed = !Exceeds(weights[w].pca * c.pca + weights[w].highlevel * c.highlevel, top[w]);
+  }
+  if ( !needed ) {
+    return;
+  }
+  c.mfcc = Compress(MfccDistance(catalog, i, queries, query));
+  for ( int w = 0; w < sets; ++w ) {
+    top[w].Push(i, Combine(c, weights[w]));
+  }
+}
+
+}  // namespace
+
+TopK::TopK(int k) : _k(k) {
+  _heap.reserve(k + 1);
+}
+
+bool TopK::Push(int index, float distance) {
+  if ( _k <= 0 ) {
+    return false;
+  }
+  Neighbour neighbour(index, distance);
+  if ( Full() ) {
+    if ( !(neighbour < _heap.front()) ) {
+      return false;
+    }
+    std::pop_heap(_heap.begin(), _heap.end());
+    _heap.back() = neighbour;
+  } else {
+    _heap.push_back(neighbour);
+  }
+  std::push_heap(_heap.begin(), _heap.end());
+  return true;
+}
+
+float TopK::Worst() const {
+  if ( !Full() ) {
+    return std::numeric_limits<float>::infinity();
+  }
+  return _heap.front().distance;
+}
+
+std::vector<Neighbour> TopK::Sorted() const {
+  std::vector<Neighbour> sorted(_heap);
+  std::sort_heap(sorted.begin(), sorted.end());
+  return sorted;
+}
+
+std::vector<Neighbour> Search(const FeatureStore &catalog, const FeatureStore &queries, int query,
+                              int k, const MetricWeights &weights, const std::vector<bool> &exclude) {
+  if ( k <= 0 ) {
+    return std::vector<Neighbour>();
+  }
+  TopK top(k);
+  bool prune = Prunable({ weights });
+  for ( int i = 0; i < catalog.Size(); ++i ) {
+    if ( !exclude.empty() && exclude[i] ) {
+      continue;
+    }
+    PushPruned(catalog, i, queries, query, &weights, 1, prune, &top);
+  }
+  return top.Sorted();
+}
+
+std::vector<std::vector<Neighbour> > BatchSearch(const FeatureStore &catalog, const FeatureStore &queries,
+                                                 const std::vector<int> &query_rows, int k,
+                                                 const MetricWeights &weights,
+                                                 const std::vector<bool> &exclude, int threads) {
+  return SweepSearch(catalog, queries, query_rows, k, { weights }, exclude, threads).front();
+}
+
+std::vector<std::vector<std::vector<Neighbour> > > SweepSearch(const FeatureStore &catalog,
+                                                               const FeatureStore &queries,
+                                                               const std::vector<int> &query_rows, int k,
+                                                               const std::vector<MetricWeights> &weights,
+                                                               const std::vector<bool> &exclude, int threads) {
+  const int size = query_rows.size();
+  const int sets = weights.size();
+  const int tiles = (size + QUERY_TILE - 1) / QUERY_TILE;
+  std::vector<std::vector<std::vector<Neighbour> > > result(sets, std::vector<std::vector<Neighbour> >(size));
+  if ( k <= 0 ) {
+    return result;
+  }
+  const bool prune = Prunable(weights);
+  std::atomic<int> next_tile(0);
+  auto worker = [&]() {
+    // heaps[q * sets + w] keeps neighbours of query 'q' of tile for weights 'w'
+    std::vector<TopK> heaps;
+    for ( int tile = next_tile++; tile < tiles; tile = next_tile++ ) {
+      const int begin = tile * QUERY_TILE;
+      const int end = std::min(begin + QUERY_TILE, size);
+      heaps.assign((end - begin) * sets, TopK(k));
+      for ( int first = 0; first < catalog.Size(); first += CATALOG_TILE ) {
+        const int last = std::min(first + CATALOG_TILE, catalog.Size());
+        for ( int q = begin; q < end; ++q ) {
+          TopK* top = &heaps[(q - begin) * sets];
+          for ( int i = first; i < last; ++i ) {
+            if ( !exclude.empty() && exclude[i] ) {
+              continue;
+            }
+            PushPruned(catalog, i, queries, query_rows[q], weights.data(), sets, prune, top);
+          }
+        }
+      }
+      for ( int q = begin; q < end; ++q ) {
+        for ( int w = 0; w < sets; ++w ) {
+          result[w][q] = heaps[(q - begin) * sets + w].Sorted();
+        }
+      }
+    }
+  };
+  std::vector<std::thread> workers;
+  for ( int t = 1; t < std::min(util::ThreadsNumber(threads), tiles); ++t ) {
+    workers.emplace_back(worker);
+  }
+  worker();
+  for ( auto &w : workers ) {
+    w.join();
+  }
+  return result;
+}
+
+std::vector<Neighbour> Rerank(const FeatureStore &catalog, const FeatureStore &queries, int query,
+                              const std::vector<Neighbour> &candidates, int k,
+                              const MetricWeights &weights) {
+  if ( k <= 0 ) {
+    return std::vector<Neighbour>();
+  }
+  TopK top(k);
+  bool prune = Prunable({ weights });
+  for ( const auto &candidate : candidates ) {
+    PushPruned(catalog, candidate.index, queries, query, &weights, 1, prune, &top);
+  }
+  return top.Sorted();
+}
+
+float Recall(const std::vector<Neighbour> &approximate, const std::vector<Neighbour> &exact) {
+  if ( exact.empty() ) {
+    return 1.0;
+  }
+  std::unordered_set<int> found;
+  for ( const auto &n : approximate ) {
+    found.insert(n.index);
+  }
+  int hits = 0;
+  for ( const auto &n : exact ) {
+    hits += found.count(n.index);
+  }
+  return static_cast<float>(hits) / exact.size();
+}
+
+}  // namespace similarity
+}  // namespace audiq
@@ -0,0 +1,108 @@
+#ifndef PROJECT_AUDIQ_SEARCH_H
+#define PROJECT_AUDIQ_SEARCH_H
+
+#include <vector>
+#include "audiq/audiq_feature_store.h"
+#include "audiq/audiq_native_metric.h"
+
+// BatchSearch tile sizes: queries of one tile share every catalog tile while it's in cache
+#define QUERY_TILE   32
+#define CATALOG_TILE 256
+// relative tolerance of lower bounds of partially computed distances, covers rounding of their sums
+#define PRUNING_SLACK 1e-5f
+
+namespace audiq {
+namespace similarity {
+
+/**
+ * @brief Neighbour Row of catalog store and its distance to query.
+ */
+struct Neighbour {
+  Neighbour(int index = -1, float distance = 0.0) : index(index), distance(distance) {}
+  bool operator<(const Neighbour &other) const {
+    return distance < other.distance || (distance == other.distance && index < other.index);
+  }
+  bool operator>(const Neighbour &other) const {
+    return other < *this;
+  }
+  int index;
+  float distance;
+};
+
+/**
+ * @brief TopK Keeps 'k' nearest neighbours pushed to it (bounded max-heap).
+ */
+class TopK {
+ public:
+  explicit TopK(int k);
+  /**
+   * Push Adds neighbour if it is closer than the worst kept one, returns true if it was added.
+   */
+  bool Push(int index, float distance);
+  /**
+   * Full Returns true if heap keeps k neighbours, heap of k <= 0 neighbours is never full (it keeps nothing).
+   */
+  bool Full() const { return _k > 0 && static_cast<int>(_heap.size()) >= _k; }
+  /**
+   * Worst Distance of the k-th neighbour, or infinity while heap isn't full.
+   */
+  float Worst() const;
+  /**
+   * Sorted Returns kept neighbours sorted by distance.
+   */
+  std::vector<Neighbour> Sorted() const;
+  void Clear() { _heap.clear(); }
+
+ private:
+  int _k;
+  std::vector<Neighbour> _heap;
+};
+
+/**
+ * @brief Search Brute-force exact search of 'k' the most similar to 'queries[query]' points of 'catalog'.
+ * Metric components are computed from the cheapest one and a point is skipped as soon as the weighted sum
+ * of computed (non-negative) components exceeds the current k-th distance, the same is done by
+ * BatchSearch, SweepSearch and Rerank.
+ * Result is empty if 'k' <= 0, the same is true for all searches.
+ * @param exclude Rows of catalog which mustn't be returned (may be empty).
+ */
+std::vector<Neighbour> Search(const FeatureStore &catalog, const FeatureStore &queries, int query,
+                              int k, const MetricWeights &weights,
+                              const std::vector<bool> &exclude = std::vector<bool>());
+/**
+ * @brief BatchSearch Exact search of 'k' the most similar points of 'catalog' for every row of 'query_rows'.
+ * Queries and catalog are swept in QUERY_TILE x CATALOG_TILE tiles with per-query top-k heaps,
+ * query tiles are distributed between 'threads' threads (0 - number of hardware threads).
+ * @return Neighbours of every query, in order of 'query_rows'.
+ */
+std::vector<std::vector<Neighbour> > BatchSearch(const FeatureStore &catalog, const FeatureStore &queries,
+                                                 const std::vector<int> &query_rows, int k,
+                                                 const MetricWeights &weights,
+                                                 const std::vector<bool> &exclude = std::vector<bool>(),
+                                                 int threads = 0);
+/**
+ * @brief SweepSearch Same as BatchSearch, but for several 'weights' at once: compressed components of every
+ * query-catalog pair are computed once and combined with each of 'weights'.
+ * @return Neighbours of every query for every weights, result[w][q] corresponds to weights[w] and query_rows[q].
+ */
+std::vector<std::vector<std::vector<Neighbour> > > SweepSearch(const FeatureStore &catalog,
+                                                               const FeatureStore &queries,
+                                                               const std::vector<int> &query_rows, int k,
+                                                               const std::vector<MetricWeights> &weights,
+                                                               const std::vector<bool> &exclude =
+                                                                   std::vector<bool>(),
+                                                               int threads = 0);
+/**
+ * @brief Rerank Sorts 'candidates' by exact distance to 'queries[query]' and returns 'k' the nearest.
+ */
+std::vector<Neighbour> Rerank(const FeatureStore &catalog, const FeatureStore &queries, int query,
+                              const std::vector<Neighbour> &candidates, int k,
+                              const MetricWeights &weights);
+/**
+ * @brief Recall Fraction of 'exact' neighbours found in 'approximate'.
+ */
+float Recall(const std::vector<Neighbour> &approximate, const std::vector<Neighbour> &exact);
+
+}  // namespace similarity
+}  // namespace audiq
+#endif  // PROJECT_AUDIQ_SEARCH_H
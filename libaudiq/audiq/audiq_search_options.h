@@ -0,0 +1,97 @@
+#ifndef PROJECT_AUDIQ_SEARCH_OPTIONS_H
+#define PROJECT_AUDIQ_SEARCH_OPTIONS_H
+
+#include <map>
+#include <string>
+#include "audiq/audiq_config.h"
+
+#define RERANK_CANDIDATES 200
+#define INDEX_EF          400
+#define VALIDATION_PAIRS     1000
+#define VALIDATION_TOLERANCE 1e-4f
+// estimated memory of loaded gaia2 dataset and its feature store relative to size of .db file
+#define DATASET_MEMORY_FACTOR 2
+// filters which match smaller part of catalog are searched exactly instead of approximately
+#define FILTER_PARTITION_FRACTION 0.25
+
+namespace audiq {
+namespace similarity {
+
+enum Quantization { QUANTIZATION_NONE, QUANTIZATION_FP16, QUANTIZATION_INT8, QUANTIZATION_PQ };
+
+/**
+ * QuantizationFromString Converts {none, fp16, int8, pq} to Quantization.
+ */
+Quantization QuantizationFromString(const std::string &name);
+
+/**
+ * @brief SampleFilter Restriction of similar samples by their metadata (see FeatureStore labels):
+ *  - labels         required values of labels, e.g. {"key": "C", "scale": "minor", "shot_or_loop": "shot"};
+ *  - min_duration   minimal duration, seconds;
+ *  - max_duration   maximal duration, seconds (0 - no limit).
+ */
+struct SampleFilter {
+  SampleFilter() : min_duration(0.0), max_duration(0.0) {}
+  bool Empty() const { return labels.empty() && min_duration <= 0.0 && max_duration <= 0.0; }
+  std::map<std::string, std::string> labels;
+  float min_duration;
+  float max_duration;
+};
+
+/**
+ * ParseSampleFilter Parses filter "LABEL=VALUE ... duration=MIN:MAX" (either bound of duration may be omitted),
+ * returns false if 'text' is malformed.
+ */
+bool ParseSampleFilter(const std::string &text, SampleFilter *filter);
+/**
+ * SampleFilterToString Converts 'filter' to text parsed by ParseSampleFilter.
+ */
+std::string SampleFilterToString(const SampleFilter &filter);
+
+/**
+ * @brief SearchOptions Options of similar samples search.
+ *  - quantity       number of the most similar samples to return;
+ *  - quantization   search on quantized pca and highlevel blocks instead of gaia2 dataset, "pq" - on product
+ *                   quantization codes of all blocks with asymmetric distance tables;
+ *  - rerank         number of quantized search candidates reranked with exact metric (0 - no rerank);
+ *  - report_recall  print recall of quantized (or index) search against similarity::CompressedDefaultMetric;
+ *  - index          take candidates from HNSW index of global dataset (saved as .hnsw next to .db),
+ *                   'rerank' of them are reranked with exact metric;
+ *  - index_ef       size of HNSW candidates list, trades recall for latency;
+ *  - validate       compare native metric against gaia2 one on global datasets before search;
+ *  - threads        number of search threads (0 - number of hardware threads);
+ *  - memory_limit   megabytes which types of many dataset mode may use when they are recommended concurrently,
+ *                   if estimated memory exceeds it types are recommended one after another (0 - no limit);
+ *  - filter         only samples matching filter are returned: selective filters are searched exactly
+ *                   in the matching partition of catalog, others with approximate search if it's enabled;
+ *  - collapse_duplicates  near-duplicates of catalog are clustered when it's loaded and only the representative
+ *                   of every cluster is searched and returned.
+ */
+struct SearchOptions {
+  SearchOptions()
+      : quantity(QUANTITY),
+        quantization(QUANTIZATION_NONE),
+        rerank(RERANK_CANDIDATES),
+        report_recall(false),
+        index(false),
+        index_ef(INDEX_EF),
+        validate(false),
+        threads(0),
+        memory_limit(0),
+        collapse_duplicates(false) {}
+  int quantity;
+  Quantization quantization;
+  int rerank;
+  bool report_recall;
+  bool index;
+  int index_ef;
+  bool validate;
+  int threads;
+  int memory_limit;
+  SampleFilter filter;
+  bool collapse_duplicates;
+};
+
+}  // namespace similarity
+}  // namespace audiq
+#endif  // PROJECT_AUDIQ_SEARCH_OPTIONS_H
@@ -0,0 +1,268 @@
+#include "audiq/audiq_server.h"
+#include <cerrno>
+#include <chrono>
+#include <thread>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <iostream>
+#include <unistd.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include "audiq/audiq_types.h"
+#include "audiq/audiq_concurrency.h"
+#include "audiq/audiq_similarity_model.h"
+
+namespace audiq {
+
+namespace {
+
+bool WriteAll(int fd, const std::string &data) {
+  for ( size_t written = 0; written < data.size(); ) {
+    // peer which has gone away is a failed write, not SIGPIPE killing the process
+    ssize_t n = send(fd, data.data() + written, data.size() - written, MSG_NOSIGNAL);
+    if ( n <= 0 ) {
+      return false;
+    }
+    written += n;
+  }
+  return true;
+}
+
+}  // namespace
+
+Server::Server(const similarity::Catalog &catalog, const ServerConfig &config, const FileRecommender *files)
+    : _catalog(catalog), _files(files), _config(config), _running(false), _socket(-1), _requests(0),
+      // extractions of 'file' and 'extract' requests share one extractor
+      _extractor(files && files->SharedExtractor()
+                 ? files->SharedExtractor()
+                 : std::make_shared<processing::Extractor>(config.extractor_profile, config.models_directory)) {}
+
+bool Server::Run() {
+  int server = socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un address = sockaddr_un();
+  address.sun_family = AF_UNIX;
+  if ( server < 0 || _config.socket_path.size() >= sizeof(address.sun_path) ) {
+    std::cout << "Can't open socket " << _config.socket_path << std::endl;
+    return false;
+  }
+  _config.socket_path.copy(address.sun_path, _config.socket_path.size());
+  unlink(_config.socket_path.c_str());
+  if ( bind(server, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0
+       || listen(server, SERVER_BACKLOG) < 0 ) {
+    std::cout << "Can't listen socket " << _config.socket_path << std::endl;
+    close(server);
+    return false;
+  }
+  _socket = server;
+  _running = true;
+  std::cout << "Audiq is serving on " << _config.socket_path << std::endl;
+  {
+    util::ThreadPool pool(_config.threads);
+    while ( _running ) {
+      int connection = accept(server, nullptr, nullptr);
+      if ( connection < 0 ) {
+        if ( !_running || errno == EINTR || errno == ECONNABORTED ) {
+          continue;
+        }
+        // e.g. no free descriptors: retrying at once would spin until some connection is closed
+        std::cout << "Can't accept connection: " << std::strerror(errno) << std::endl;
+        std::this_thread::sleep_for(std::chrono::milliseconds(SERVER_ACCEPT_BACKOFF));
+        continue;
+      }
+      pool.Submit([this, connection] { HandleConnection(connection); });
+    }
+  }
+  close(server);
+  unlink(_config.socket_path.c_str());
+  return true;
+}
+
+void Server::Stop() {
+  _running = false;
+  // wakes up accept
+  shutdown(_socket, SHUT_RDWR);
+}
+
+void Server::HandleConnection(int connection) {
+  // silent clients don't keep worker threads
+  timeval timeout = timeval();
+  timeout.tv_sec = SERVER_TIMEOUT;
+  setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  setsockopt(connection, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+  std::string request;
+  char buffer[256];
+  ssize_t size = 0;
+  while ( request.find('\n') == std::string::npos && request.size() < SERVER_REQUEST_MAX
+          && (size = read(connection, buffer, sizeof(buffer))) > 0 ) {
+    request.append(buffer, size);
+  }
+  if ( size < 0 && request.find('\n') == std::string::npos ) {
+    WriteAll(connection, "error: request wasn't received\n");
+  } else {
+    WriteAll(connection, Handle(request.substr(0, request.find('\n'))));
+  }
+  close(connection);
+}
+
+std::string Server::Handle(const std::string &request) {
+  // any failure of request is its response, it doesn't stop server
+  try {
+    return Dispatch(request);
+  }
+  catch ( std::exception &e ) {
+    return string("error: ") + e.what() + "\n";
+  }
+}
+
+std::string Server::Dispatch(const std::string &request) {
+  similarity::SearchOptions search_options = _config.search_options;
+  // requests are already searched concurrently on threads of pool
+  search_options.threads = 1;
+  size_t where = request.find(" where ");
+  if ( request.compare(0, 5, "like ") == 0 ) {
+    where = std::string::npos;
+  }
+  if ( where != std::string::npos
+       && !similarity::ParseSampleFilter(request.substr(where + 7), &search_options.filter) ) {
+    return "error: wrong filter, expected 'where LABEL=VALUE ... duration=MIN:MAX'\n";
+  }
+  std::istringstream input(request.substr(0, where));
+  string command, target, mode;
+  input >> command;
+  if ( command == "like" ) {
+    // file names may contain spaces, so sample is the rest of request
+    std::getline(input >> std::ws, target);
+    types::audiq_neighbours similar = _catalog.MoreLikeThis(target, _config.search_options.quantity);
+    if ( similar.empty() ) {
+      return "error: no such sample " + target + "\n";
+    }
+    return ResultToYaml(similarity::SimilarNames(similar));
+  }
+  if ( command == "file" ) {
+    std::getline(input >> std::ws, target);
+    if ( !_files ) {
+      return "error: global datasets weren't built by streaming build\n";
+    }
+    if ( !filesystem::exists(target) ) {
+      return "error: no such file " + target + "\n";
+    }
+    return ResultToYaml(_files->RecommendForFile(target, _config.weights, search_options));
+  }
+  input >> target;
+  bool one_dataset = _config.one_dataset;
+  vector<float> weights = _config.weights;
+  if ( input >> mode ) {
+    if ( mode != "one" && mode != "many" ) {
+      return "error: dataset mode must be one or many\n";
+    }
+    one_dataset = mode == "one";
+    vector<float> w(3);
+    if ( input >> w[0] >> w[1] >> w[2] ) {
+      weights = w;
+    }
+  }
+  if ( target.empty() ) {
+    return "error: wrong request, expected 'recommend USER_DATASET_NAME' or 'extract SAMPLES_DIRECTORY'\n";
+  }
+  if ( command == "recommend" ) {
+    return ResultToYaml(_catalog.Recommend(one_dataset, target, weights, search_options));
+  }
+  if ( command == "neighbours" ) {
+    return NeighboursToText(_catalog.Neighbours(one_dataset, target, weights, search_options));
+  }
+  if ( command == "extract" ) {
+    if ( !filesystem::exists(target) ) {
+      return "error: no such directory " + target + "\n";
+    }
+    return ResultToYaml(Extract(target, one_dataset, weights, search_options));
+  }
+  return "error: unknown command " + command + "\n";
+}
+
+audiq_similar Server::Extract(const std::string &samples_directory, bool one_dataset,
+                              const std::vector<float> &weights, const similarity::SearchOptions &options) {
+  string work = _config.work_directory + "/request_" + std::to_string(_requests++);
+  filesystem::create_directories(work);
+  audiq_similar similar;
+  // work directory of failed request is removed too
+  try {
+    processing::SamplesToDataSet(samples_directory, work + "/descriptors/", _extractor.get(), "part",
+                                 _config.samples_in_dataset, work + "/parts/", work + "/user_dataset");
+    similar = _catalog.Recommend(one_dataset, work + "/user_dataset", weights, options);
+  }
+  catch ( ... ) {
+    filesystem::remove_all(work);
+    throw;
+  }
+  filesystem::remove_all(work);
+  return similar;
+}
+
+std::string SendRequest(const std::string &socket_path, const std::string &request) {
+  int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un address = sockaddr_un();
+  address.sun_family = AF_UNIX;
+  if ( connection < 0 || socket_path.size() >= sizeof(address.sun_path) ) {
+    if ( connection >= 0 ) {
+      close(connection);
+    }
+    return "error: can't open socket " + socket_path + "\n";
+  }
+  socket_path.copy(address.sun_path, socket_path.size());
+  if ( connect(connection, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0
+       || !WriteAll(connection, request + "\n") ) {
+    close(connection);
+    return "error: can't connect to " + socket_path + "\n";
+  }
+  std::string response;
+  char buffer[4096];
+  ssize_t size;
+  while ( (size = read(connection, buffer, sizeof(buffer))) > 0 ) {
+    response.append(buffer, size);
+  }
+  close(connection);
+  return response;
+}
+
+std::string NeighboursToText(const types::audiq_neighbours &neighbours) {
+  std::ostringstream output;
+  output.precision(9);
+  for ( const auto &pair : neighbours ) {
+    output << pair.first;
+    for ( const auto &n : pair.second ) {
+      output << '\t' << n.first << '\t' << n.second;
+    }
+    output << '\n';
+  }
+  return output.str();
+}
+
+bool NeighboursFromText(const std::string &text, types::audiq_neighbours *neighbours) {
+  if ( text.compare(0, 6, "error:") == 0 ) {
+    return false;
+  }
+  std::istringstream input(text);
+  string line;
+  while ( std::getline(input, line) ) {
+    std::istringstream fields(line);
+    string name, similar, distance;
+    std::getline(fields, name, '\t');
+    vector<std::pair<string, float> > &similars = (*neighbours)[name];
+    while ( std::getline(fields, similar, '\t') ) {
+      char* end = nullptr;
+      if ( !std::getline(fields, distance, '\t') ) {
+        return false;
+      }
+      float value = std::strtof(distance.c_str(), &end);
+      if ( end == distance.c_str() ) {
+        return false;
+      }
+      similars.push_back(std::make_pair(similar, value));
+    }
+  }
+  return true;
+}
+
+}  // namespace audiq
@@ -0,0 +1,115 @@
+#ifndef PROJECT_AUDIQ_SERVER_H
+#define PROJECT_AUDIQ_SERVER_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include "audiq/audiq.h"
+#include "audiq/audiq_config.h"
+#include "audiq/audiq_catalog.h"
+#include "audiq/audiq_processing.h"
+#include "audiq/audiq_search_options.h"
+#include "audiq/audiq_file_recommender.h"
+
+#define SERVER_SOCKET      "audiq.sock"
+#define SERVER_BACKLOG     64
+#define SERVER_REQUEST_MAX 4096
+// seconds a connection may wait for reading request or writing response
+#define SERVER_TIMEOUT     30
+// milliseconds accept waits after failure (e.g. no free descriptors) before it tries again
+#define SERVER_ACCEPT_BACKOFF 100
+
+namespace audiq {
+
+/**
+ * @brief ServerConfig Settings of Server: socket, worker threads, defaults of requests and extraction settings.
+ */
+struct ServerConfig {
+  ServerConfig()
+      : socket_path(SERVER_SOCKET),
+        threads(0),
+        one_dataset(false),
+        weights({ 1.0, 1.0, 1.0 }),
+        models_directory(MODELS_DIR),
+        samples_in_dataset(SAMPLES_PER_DATASET),
+        work_directory("audiq_requests") {}
+  std::string socket_path;
+  int threads;
+  bool one_dataset;
+  std::vector<float> weights;
+  similarity::SearchOptions search_options;
+  std::string extractor_profile;
+  std::string models_directory;
+  int samples_in_dataset;
+  // temporary descriptors and datasets of extract requests are created here
+  std::string work_directory;
+};
+
+/**
+ * @brief Server Recommendation daemon: answers requests on unix socket using resident 'catalog'.
+ * Every connection carries one request line:
+ *   recommend USER_DATASET_NAME [one|many] [W1 W2 W3]
+ *   extract SAMPLES_DIRECTORY [one|many] [W1 W2 W3]
+ *   neighbours USER_DATASET_NAME [one|many] [W1 W2 W3]
+ *   like SAMPLE
+ *   file AUDIO_FILE
+ * Every request but 'like' may end with "where FILTER" (see similarity::ParseSampleFilter), then only
+ * samples matching the filter are recommended.
+ * 'recommend' searches already created user datasets, 'extract' creates them from samples first.
+ * Response is the result YAML (the same as result file) or a line "error: MESSAGE".
+ * 'neighbours' is the same as 'recommend', but response is NeighboursToText of result (used by RemoteShard).
+ * 'like' answers from kNN graphs of catalog, which are built with default weights (see Catalog::MoreLikeThis).
+ * 'file' extracts single audio file and searches it with 'files' recommender (see FileRecommender).
+ * Requests are handled concurrently on 'config.threads' threads, every request is searched on its own thread.
+ * Extractor and classifiers of 'extract' requests are loaded once by constructor, extractions run one at a time.
+ */
+class Server {
+ public:
+  /**
+   * Server 'files' may be nullptr, then 'file' requests are answered with error.
+   * Otherwise server extracts with the resident extractor of 'files'.
+   */
+  Server(const similarity::Catalog &catalog, const ServerConfig &config, const FileRecommender *files = nullptr);
+  /**
+   * Run Serves requests until Stop is called, returns false if socket can't be opened.
+   */
+  bool Run();
+  void Stop();
+  /**
+   * Handle Answers one 'request' line.
+   */
+  std::string Handle(const std::string &request);
+
+ private:
+  void HandleConnection(int connection);
+  std::string Dispatch(const std::string &request);
+  audiq_similar Extract(const std::string &samples_directory, bool one_dataset,
+                        const std::vector<float> &weights, const similarity::SearchOptions &options);
+
+  const similarity::Catalog &_catalog;
+  const FileRecommender* _files;
+  ServerConfig _config;
+  std::atomic<bool> _running;
+  std::atomic<int> _socket;
+  std::atomic<unsigned> _requests;
+  std::shared_ptr<processing::Extractor> _extractor;
+};
+
+/**
+ * SendRequest Sends 'request' line to server on 'socket_path' and returns its response.
+ */
+std::string SendRequest(const std::string &socket_path, const std::string &request);
+
+/**
+ * NeighboursToText Serializes 'neighbours': one line per sample, file name of sample is followed
+ * by file names and distances of similar samples, all separated by tabs.
+ */
+std::string NeighboursToText(const types::audiq_neighbours &neighbours);
+/**
+ * NeighboursFromText Parses result of NeighboursToText, returns false if 'text' is malformed.
+ */
+bool NeighboursFromText(const std::string &text, types::audiq_neighbours *neighbours);
+
+}  // namespace audiq
+#endif  // PROJECT_AUDIQ_SERVER_H
@@ -0,0 +1,125 @@
+#include "audiq/audiq_shards.h"
+#include <thread>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include "gaia2/gaia.h"
+#include "gaia2/dataset.h"
+#include "audiq/audiq_util.h"
+#include "audiq/audiq_server.h"
+#include "audiq/audiq_concurrency.h"
+#include "audiq/audiq_similarity_model.h"
+
+namespace audiq {
+
+LocalShard::LocalShard(const std::string &shard_dataset_name, const similarity::SearchOptions &options)
+    : _name(shard_dataset_name) {
+  _loaded = _catalog.Load(shard_dataset_name, options);
+}
+
+bool LocalShard::Neighbours(bool one_dataset, const std::string &user_dataset_name,
+                            const std::vector<float> &weights, const similarity::SearchOptions &options,
+                            types::audiq_neighbours *neighbours) {
+  if ( !_loaded ) {
+    return false;
+  }
+  *neighbours = _catalog.Neighbours(one_dataset, user_dataset_name, weights, options);
+  return true;
+}
+
+bool RemoteShard::Neighbours(bool one_dataset, const std::string &user_dataset_name,
+                             const std::vector<float> &weights, const similarity::SearchOptions &options,
+                             types::audiq_neighbours *neighbours) {
+  // search options of remote shard are the ones it was started with, except filter
+  std::ostringstream request;
+  // weights are sent exactly (9 digits round-trip float), so remote shard searches with the same metric
+  request.precision(9);
+  request << "neighbours " << user_dataset_name << (one_dataset ? " one" : " many");
+  for ( auto w : weights ) {
+    request << " " << w;
+  }
+  if ( !options.filter.Empty() ) {
+    request << " where " << similarity::SampleFilterToString(options.filter);
+  }
+  return NeighboursFromText(SendRequest(_socket_path, request.str()), neighbours);
+}
+
+std::string ShardName(const std::string &global_dataset_name, int shard) {
+  return global_dataset_name + "_shard" + std::to_string(shard);
+}
+
+void SplitDataSet(const std::string &global_dataset_name, int shards) {
+  using gaia2::DataSet;
+  util::InitGaia();
+  for ( auto t : types::TYPES ) {
+    string name = global_dataset_name + "_" + t + ".db";
+    if ( !filesystem::exists(name) ) {
+      continue;
+    }
+    DataSet dataset;
+    dataset.load(QString::fromStdString(name));
+    // every point is added to its own shard only, global dataset isn't copied per shard
+    std::vector<gaia2::PointArray> parts(shards);
+    for ( int i = 0; i < dataset.size(); ++i ) {
+      parts[i % shards] << dataset.at(i);
+    }
+    for ( int shard = 0; shard < shards; ++shard ) {
+      DataSet part;
+      part.addPoints(parts[shard]);
+      // history of global dataset is kept, so user points are prepared in the same way
+      part.setHistory(dataset.history());
+      part.save(QString::fromStdString(ShardName(global_dataset_name, shard) + "_" + t + ".db"));
+    }
+    std::cout << name << " is splitted into " << shards << " shards" << std::endl;
+  }
+}
+
+audiq_similar ScatterGather(const std::vector<Shard*> &shards, bool one_dataset,
+                            const std::string &user_dataset_name, const std::vector<float> &weights,
+                            const similarity::SearchOptions &options) {
+  std::vector<types::audiq_neighbours> answers(shards.size());
+  std::vector<char> answered(shards.size(), false);
+  // every shard gets its share of search threads
+  similarity::SearchOptions shard_options = options;
+  shard_options.threads = std::max(1, util::ThreadsNumber(options.threads) / std::max<int>(1, shards.size()));
+  std::vector<std::thread> workers;
+  for ( size_t s = 0; s < shards.size(); ++s ) {
+    workers.emplace_back([&, s] {
+      // failed shard (e.g. it can't load user dataset) is reported as not answered
+      try {
+        answered[s] = shards[s]->Neighbours(one_dataset, user_dataset_name, weights, shard_options, &answers[s]);
+      }
+      catch ( std::exception &e ) {
+        std::cout << "Shard " << shards[s]->Name() << ": " << e.what() << std::endl;
+        answered[s] = false;
+      }
+    });
+  }
+  for ( auto &w : workers ) {
+    w.join();
+  }
+  types::audiq_neighbours merged;
+  for ( size_t s = 0; s < shards.size(); ++s ) {
+    if ( !answered[s] ) {
+      std::cout << "Shard " << shards[s]->Name() << " didn't answer" << std::endl;
+      continue;
+    }
+    for ( auto &pair : answers[s] ) {
+      auto &similar = merged[pair.first];
+      similar.insert(similar.end(), pair.second.begin(), pair.second.end());
+    }
+  }
+  for ( auto &pair : merged ) {
+    auto &similar = pair.second;
+    std::sort(similar.begin(), similar.end(),
+              [](const std::pair<string, float> &a, const std::pair<string, float> &b) {
+                return a.second < b.second || (a.second == b.second && a.first < b.first);
+              });
+    if ( static_cast<int>(similar.size()) > options.quantity ) {
+      similar.resize(options.quantity);
+    }
+  }
+  return similarity::SimilarNames(merged);
+}
+
+}  // namespace audiq
@@ -0,0 +1,84 @@
+#ifndef PROJECT_AUDIQ_SHARDS_H
+#define PROJECT_AUDIQ_SHARDS_H
+
+#include <string>
+#include <vector>
+#include "audiq/audiq.h"
+#include "audiq/audiq_types.h"
+#include "audiq/audiq_catalog.h"
+#include "audiq/audiq_search_options.h"
+
+namespace audiq {
+
+/**
+ * @brief Shard Part of global datasets which finds neighbours of user samples on its own.
+ */
+class Shard {
+ public:
+  virtual ~Shard() {}
+  /**
+   * Neighbours Same as similarity::Catalog::Neighbours for global datasets of shard.
+   * @return false if shard failed to answer.
+   */
+  virtual bool Neighbours(bool one_dataset, const std::string &user_dataset_name, const std::vector<float> &weights,
+                          const similarity::SearchOptions &options, types::audiq_neighbours *neighbours) = 0;
+  virtual std::string Name() const = 0;
+};
+
+/**
+ * @brief LocalShard Shard loaded into this process.
+ */
+class LocalShard : public Shard {
+ public:
+  /**
+   * LocalShard Loads shard datasets 'shard_dataset_name'_TYPE.db (see ShardName).
+   */
+  LocalShard(const std::string &shard_dataset_name, const similarity::SearchOptions &options);
+  bool Loaded() const { return _loaded; }
+  bool Neighbours(bool one_dataset, const std::string &user_dataset_name, const std::vector<float> &weights,
+                  const similarity::SearchOptions &options, types::audiq_neighbours *neighbours) override;
+  std::string Name() const override { return _name; }
+
+ private:
+  std::string _name;
+  similarity::Catalog _catalog;
+  bool _loaded;
+};
+
+/**
+ * @brief RemoteShard Shard served by other audiq process ("audiq -s SOCKET" with shard as global dataset).
+ * @note User datasets are read by that process, so it must see the same files.
+ */
+class RemoteShard : public Shard {
+ public:
+  explicit RemoteShard(const std::string &socket_path) : _socket_path(socket_path) {}
+  bool Neighbours(bool one_dataset, const std::string &user_dataset_name, const std::vector<float> &weights,
+                  const similarity::SearchOptions &options, types::audiq_neighbours *neighbours) override;
+  std::string Name() const override { return _socket_path; }
+
+ private:
+  std::string _socket_path;
+};
+
+/**
+ * @brief ShardName Name of global datasets of 'shard' of 'global_dataset_name'.
+ */
+std::string ShardName(const std::string &global_dataset_name, int shard);
+
+/**
+ * @brief SplitDataSet Splits every global dataset 'global_dataset_name'_TYPE.db into 'shards' datasets
+ * ShardName(global_dataset_name, i)_TYPE.db, points are distributed round-robin.
+ */
+void SplitDataSet(const std::string &global_dataset_name, int shards);
+
+/**
+ * @brief ScatterGather Asks all 'shards' concurrently and merges their neighbours by distance,
+ * so the result is the same as recommendation with not splitted global datasets.
+ * Shards which failed to answer are skipped with a message.
+ */
+audiq_similar ScatterGather(const std::vector<Shard*> &shards, bool one_dataset,
+                            const std::string &user_dataset_name, const std::vector<float> &weights,
+                            const similarity::SearchOptions &options);
+
+}  // namespace audiq
+#endif  // PROJECT_AUDIQ_SHARDS_H
@@ -0,0 +1,224 @@
+#include "audiq/audiq_simd.h"
+#include <atomic>
+#include "audiq/audiq_aligned_block.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define AUDIQ_SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace audiq {
+namespace similarity {
+
+namespace {
+
+float ScalarSquaredDistance(const float *a, const float *b, int n) {
+  float sum = 0.0;
+  for ( int d = 0; d < n; ++d ) {
+    float diff = a[d] - b[d];
+    sum += diff * diff;
+  }
+  return sum;
+}
+
+float ScalarDotPair(const float *a1, const float *b1, const float *a2, const float *b2, int n) {
+  float sum = 0.0;
+  for ( int d = 0; d < n; ++d ) {
+    sum += a1[d] * b1[d] + a2[d] * b2[d];
+  }
+  return sum;
+}
+
+Moments ScalarMoments(const float *a, const float *b, int n) {
+  Moments m = { 0.0, 0.0, 0.0, 0.0, 0.0 };
+  for ( int d = 0; d < n; ++d ) {
+    m.a += a[d];
+    m.b += b[d];
+    m.ab += a[d] * b[d];
+    m.aa += a[d] * a[d];
+    m.bb += b[d] * b[d];
+  }
+  return m;
+}
+
+#ifdef AUDIQ_SIMD_X86
+
+__attribute__((target("avx2,fma")))
+float Sum256(__m256 v) {
+  __m128 sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+  sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+  return _mm_cvtss_f32(sum);
+}
+
+__attribute__((target("avx2,fma")))
+float Avx2SquaredDistance(const float *a, const float *b, int n) {
+  __m256 sum0 = _mm256_setzero_ps();
+  __m256 sum1 = _mm256_setzero_ps();
+  for ( int d = 0; d < n; d += 16 ) {
+    __m256 diff0 = _mm256_sub_ps(_mm256_loadu_ps(a + d), _mm256_loadu_ps(b + d));
+    __m256 diff1 = _mm256_sub_ps(_mm256_loadu_ps(a + d + 8), _mm256_loadu_ps(b + d + 8));
+    sum0 = _mm256_fmadd_ps(diff0, diff0, sum0);
+    sum1 = _mm256_fmadd_ps(diff1, diff1, sum1);
+  }
+  return Sum256(_mm256_add_ps(sum0, sum1));
+}
+
+__attribute__((target("avx2,fma")))
+float Avx2DotPair(const float *a1, const float *b1, const float *a2, const float *b2, int n) {
+  __m256 sum0 = _mm256_setzero_ps();
+  __m256 sum1 = _mm256_setzero_ps();
+  for ( int d = 0; d < n; d += 8 ) {
+    sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(a1 + d), _mm256_loadu_ps(b1 + d), sum0);
+    sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(a2 + d), _mm256_loadu_ps(b2 + d), sum1);
+  }
+  return Sum256(_mm256_add_ps(sum0, sum1));
+}
+
+__attribute__((target("avx2,fma")))
+Moments Avx2Moments(const float *a, const float *b, int n) {
+  __m256 sa = _mm256_setzero_ps(), sb = _mm256_setzero_ps();
+  __m256 sab = _mm256_setzero_ps(), saa = _mm256_setzero_ps(), sbb = _mm256_setzero_ps();
+  for ( int d = 0; d < n; d += 8 ) {
+    __m256 va = _mm256_loadu_ps(a + d);
+    __m256 vb = _mm256_loadu_ps(b + d);
+    sa = _mm256_add_ps(sa, va);
+    sb = _mm256_add_ps(sb, vb);
+    sab = _mm256_fmadd_ps(va, vb, sab);
+    saa = _mm256_fmadd_ps(va, va, saa);
+    sbb = _mm256_fmadd_ps(vb, vb, sbb);
+  }
+  Moments m = { Sum256(sa), Sum256(sb), Sum256(sab), Sum256(saa), Sum256(sbb) };
+  return m;
+}
+
+__attribute__((target("avx512f")))
+float Sum512(__m512 v) {
+  alignas(BLOCK_ALIGNMENT) float lanes[16];
+  _mm512_store_ps(lanes, v);
+  __m256 half = _mm256_add_ps(_mm256_load_ps(lanes), _mm256_load_ps(lanes + 8));
+  __m128 sum = _mm_add_ps(_mm256_castps256_ps128(half), _mm256_extractf128_ps(half, 1));
+  sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+  sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+  return _mm_cvtss_f32(sum);
+}
+
+__attribute__((target("avx512f")))
+float Avx512SquaredDistance(const float *a, const float *b, int n) {
+  __m512 sum = _mm512_setzero_ps();
+  for ( int d = 0; d < n; d += 16 ) {
+    __m512 diff = _mm512_sub_ps(_mm512_loadu_ps(a + d), _mm512_loadu_ps(b + d));
+    sum = _mm512_fmadd_ps(diff, diff, sum);
+  }
+  return Sum512(sum);
+}
+
+__attribute__((target("avx512f")))
+float Avx512DotPair(const float *a1, const float *b1, const float *a2, const float *b2, int n) {
+  __m512 sum0 = _mm512_setzero_ps();
+  __m512 sum1 = _mm512_setzero_ps();
+  for ( int d = 0; d < n; d += 16 ) {
+    sum0 = _mm512_fmadd_ps(_mm512_loadu_ps(a1 + d), _mm512_loadu_ps(b1 + d), sum0);
+    sum1 = _mm512_fmadd_ps(_mm512_loadu_ps(a2 + d), _mm512_loadu_ps(b2 + d), sum1);
+  }
+  return Sum512(_mm512_add_ps(sum0, sum1));
+}
+
+__attribute__((target("avx512f")))
+Moments Avx512Moments(const float *a, const float *b, int n) {
+  __m512 sa = _mm512_setzero_ps(), sb = _mm512_setzero_ps();
+  __m512 sab = _mm512_setzero_ps(), saa = _mm512_setzero_ps(), sbb = _mm512_setzero_ps();
+  for ( int d = 0; d < n; d += 16 ) {
+    __m512 va = _mm512_loadu_ps(a + d);
+    __m512 vb = _mm512_loadu_ps(b + d);
+    sa = _mm512_add_ps(sa, va);
+    sb = _mm512_add_ps(sb, vb);
+    sab = _mm512_fmadd_ps(va, vb, sab);
+    saa = _mm512_fmadd_ps(va, va, saa);
+    sbb = _mm512_fmadd_ps(vb, vb, sbb);
+  }
+  Moments m = { Sum512(sa), Sum512(sb), Sum512(sab), Sum512(saa), Sum512(sbb) };
+  return m;
+}
+
+#endif  // AUDIQ_SIMD_X86
+
+const Kernels scalar_kernels = { ISA_SCALAR, ScalarSquaredDistance, ScalarDotPair, ScalarMoments };
+#ifdef AUDIQ_SIMD_X86
+const Kernels avx2_kernels = { ISA_AVX2, Avx2SquaredDistance, Avx2DotPair, Avx2Moments };
+const Kernels avx512_kernels = { ISA_AVX512, Avx512SquaredDistance, Avx512DotPair, Avx512Moments };
+#endif
+
+std::atomic<const Kernels*> active_kernels(nullptr);
+
+}  // namespace
+
+Isa DetectIsa() {
+#ifdef AUDIQ_SIMD_X86
+  __builtin_cpu_init();
+  if ( __builtin_cpu_supports("avx512f") ) {
+    return ISA_AVX512;
+  }
+  if ( __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") ) {
+    return ISA_AVX2;
+  }
+#endif
+  return ISA_SCALAR;
+}
+
+const Kernels& KernelsFor(Isa isa) {
+#ifdef AUDIQ_SIMD_X86
+  if ( isa > DetectIsa() ) {
+    isa = DetectIsa();
+  }
+  switch ( isa ) {
+  case ISA_AVX512:
+    return avx512_kernels;
+  case ISA_AVX2:
+    return avx2_kernels;
+  default:
+    break;
+  }
+#endif
+  return scalar_kernels;
+}
+
+const Kernels& ActiveKernels() {
+  const Kernels* kernels = active_kernels.load(std::memory_order_acquire);
+  if ( !kernels ) {
+    kernels = &KernelsFor(DetectIsa());
+    active_kernels.store(kernels, std::memory_order_release);
+  }
+  return *kernels;
+}
+
+void SetIsa(Isa isa) {
+  active_kernels.store(&KernelsFor(isa), std::memory_order_release);
+}
+
+Isa IsaFromString(const std::string &name) {
+  if ( name == "scalar" ) {
+    return ISA_SCALAR;
+  }
+  if ( name == "avx2" ) {
+    return ISA_AVX2;
+  }
+  if ( name == "avx512" ) {
+    return ISA_AVX512;
+  }
+  return DetectIsa();
+}
+
+std::string IsaName(Isa isa) {
+  switch ( isa ) {
+  case ISA_AVX512:
+    return "avx512";
+  case ISA_AVX2:
+    return "avx2";
+  default:
+    return "scalar";
+  }
+}
+
+}  // namespace similarity
+}  // namespace audiq
@@ -0,0 +1,66 @@
+#ifndef PROJECT_AUDIQ_SIMD_H
+#define PROJECT_AUDIQ_SIMD_H
+
+#include <string>
+
+namespace audiq {
+namespace similarity {
+
+/**
+ * @brief Isa Instruction sets of native metric kernels.
+ */
+enum Isa { ISA_SCALAR, ISA_AVX2, ISA_AVX512 };
+
+/**
+ * @brief Moments Sums needed for Pearson correlation of two vectors.
+ */
+struct Moments {
+  float a;
+  float b;
+  float ab;
+  float aa;
+  float bb;
+};
+
+/**
+ * @brief Kernels Vector kernels used by native metric.
+ * All kernels take 'n' values which must be a multiple of 16 (rows of AlignedBlock are zero-padded
+ * to such stride), so there is no tail processing.
+ */
+struct Kernels {
+  Isa isa;
+  /** squared_distance Sum of (a - b)^2 */
+  float (*squared_distance)(const float *a, const float *b, int n);
+  /** dot_pair Sum of a1 * b1 + a2 * b2 */
+  float (*dot_pair)(const float *a1, const float *b1, const float *a2, const float *b2, int n);
+  /** moments Sums of a, b, a * b, a^2, b^2 */
+  Moments (*moments)(const float *a, const float *b, int n);
+};
+
+/**
+ * @brief DetectIsa The best instruction set supported by CPU (and compiler).
+ */
+Isa DetectIsa();
+/**
+ * @brief KernelsFor Kernels of 'isa', scalar kernels if it isn't supported.
+ */
+const Kernels& KernelsFor(Isa isa);
+/**
+ * @brief ActiveKernels Kernels used by native metric, selected by DetectIsa on first call.
+ */
+const Kernels& ActiveKernels();
+/**
+ * @brief SetIsa Forces kernels used by native metric (it's clamped to DetectIsa()).
+ * @note Must not be called while search is running.
+ */
+void SetIsa(Isa isa);
+
+/**
+ * @brief IsaFromString Converts "scalar", "avx2", "avx512" to Isa, anything else means DetectIsa().
+ */
+Isa IsaFromString(const std::string &name);
+std::string IsaName(Isa isa);
+
+}  // namespace similarity
+}  // namespace audiq
+#endif  // PROJECT_AUDIQ_SIMD_H
@@ -1,58 +1,398 @@
 #include "audiq/audiq_similarity_model.h"
+#include <cmath>
+#include <memory>
+#include <random>
+#include <algorithm>
+#include <functional>
 #include "gaia2/gaia.h"
-#include "gaia2/view.h"
 #include "gaia2/utils.h"
 #include "gaia2/transformation.h"
 #include "gaia2/distancefunction.h"
 #include "audiq/audiq_util.h"
 #include "audiq/audiq_types.h"
 #include "audiq/audiq_config.h"
+#include "audiq/audiq_search.h"
+#include "audiq/audiq_feature_store.h"
+#include "audiq/audiq_quantized_store.h"
+#include "audiq/audiq_duplicates.h"
+#include "audiq/audiq_hnsw_index.h"
+#include "audiq/audiq_metadata_index.h"
+#include "audiq/audiq_simd.h"
+#include "audiq/audiq_concurrency.h"
 
 namespace audiq {
 namespace similarity {
 
+namespace {
+
+vector<int> AllRows(const FeatureStore &store) {
+  vector<int> rows(store.Size());
+  for ( int i = 0; i < store.Size(); ++i ) {
+    rows[i] = i;
+  }
+  return rows;
+}
+
+/**
+ * Exclusion Marks rows of 'catalog' which mustn't be recommended: rows which are in 'queries' too,
+ * rows not matching 'options.filter' (found with 'metadata' if it's given) and near-duplicates of other rows
+ * if 'options.collapse_duplicates' is set. Returns empty vector if there are no such rows.
+ * @param matching Set to number of rows matching filter, if it's given.
+ */
+vector<bool> Exclusion(const FeatureStore &catalog, const FeatureStore &queries, const SearchOptions &options,
+                       const MetadataIndex *metadata = nullptr, size_t *matching = nullptr) {
+  vector<bool> exclude;
+  if ( matching ) {
+    *matching = catalog.Size();
+  }
+  if ( !options.filter.Empty() ) {
+    // matching rows aren't copied, the others are skipped by search
+    vector<int> rows = metadata ? metadata->Rows(options.filter) : MatchingRows(catalog, options.filter);
+    vector<bool> match(catalog.Size(), false);
+    for ( auto i : rows ) {
+      match[i] = true;
+    }
+    exclude.resize(catalog.Size(), false);
+    for ( int i = 0; i < catalog.Size(); ++i ) {
+      exclude[i] = exclude[i] || !match[i];
+    }
+    if ( matching ) {
+      *matching = rows.size();
+    }
+  }
+  for ( int q = 0; q < queries.Size(); ++q ) {
+    int i = catalog.IndexOf(queries.PointName(q));
+    if ( i >= 0 ) {
+      exclude.resize(catalog.Size(), false);
+      exclude[i] = true;
+    }
+  }
+  // representatives of clusters are chosen among rows which may be recommended
+  if ( options.collapse_duplicates ) {
+    vector<bool> duplicates = DuplicateRows(catalog, exclude);
+    if ( !duplicates.empty() ) {
+      exclude.resize(catalog.Size(), false);
+      for ( int i = 0; i < catalog.Size(); ++i ) {
+        exclude[i] = exclude[i] || duplicates[i];
+      }
+    }
+  }
+  return exclude;
+}
+
+/**
+ * ToNeighbours Converts neighbours of every query to file names of samples and distances.
+ */
+types::audiq_neighbours ToNeighbours(const FeatureStore &catalog, const FeatureStore &queries,
+                                     const vector<vector<Neighbour> > &result) {
+  types::audiq_neighbours neighbours;
+  for ( int q = 0; q < queries.Size(); ++q ) {
+    vector<std::pair<string, float> > &similar = neighbours[queries.FileName(q)];
+    for ( const auto &n : result[q] ) {
+      similar.push_back(std::make_pair(catalog.FileName(n.index), n.distance));
+    }
+  }
+  return neighbours;
+}
+
+/**
+ * SearchStore Searches 'options.quantity' the most similar to 'queries[query]' points of 'catalog'.
+ * Candidates are taken from 'indexes' or 'quantized' copy of catalog if they are given, and reranked.
+ */
+vector<Neighbour> SearchStore(const FeatureStore &catalog, const QuantizedStore *quantized,
+                              const vector<const HnswIndex*> &indexes, const FeatureStore &queries, int query,
+                              const vector<bool> &exclude, const MetricWeights &weights,
+                              const SearchOptions &options) {
+  int quantity = options.quantity;
+  if ( !indexes.empty() ) {
+    vector<Neighbour> candidates;
+    for ( auto index : indexes ) {
+      for ( const auto &n : index->Search(queries.Pca().Row(query), std::max(quantity, options.rerank),
+                                          options.index_ef) ) {
+        // index of catalog type has the same points order, then node is catalog row
+        int i = n.index < catalog.Size() && catalog.PointName(n.index) == index->PointName(n.index)
+                ? n.index : catalog.IndexOf(index->PointName(n.index));
+        if ( i >= 0 && (exclude.empty() || !exclude[i]) ) {
+          candidates.push_back(Neighbour(i, n.distance));
+        }
+      }
+    }
+    return Rerank(catalog, queries, query, candidates, quantity, weights);
+  }
+  vector<Neighbour> candidates = QuantizedSearch(*quantized, queries, query, std::max(quantity, options.rerank),
+                                                 weights, exclude);
+  if ( options.rerank > 0 ) {
+    return Rerank(catalog, queries, query, candidates, quantity, weights);
+  }
+  candidates.resize(std::min<size_t>(quantity, candidates.size()));
+  return candidates;
+}
+
+/**
+ * SearchQueries Searches similar points of 'catalog' for every point of 'queries': approximately
+ * (one query after another) if 'quantized' catalog or 'indexes' are given, otherwise with batched exact search.
+ */
+vector<vector<Neighbour> > SearchQueries(const FeatureStore &catalog, const QuantizedStore *quantized,
+                                         const vector<const HnswIndex*> &indexes, const FeatureStore &queries,
+                                         const vector<bool> &exclude, const MetricWeights &weights,
+                                         const SearchOptions &options) {
+  if ( !quantized && indexes.empty() ) {
+    return BatchSearch(catalog, queries, AllRows(queries), options.quantity, weights, exclude, options.threads);
+  }
+  vector<vector<Neighbour> > result;
+  for ( int q = 0; q < queries.Size(); ++q ) {
+    result.push_back(SearchStore(catalog, quantized, indexes, queries, q, exclude, weights, options));
+  }
+  return result;
+}
+
+/**
+ * BuildStores Builds catalog store of 'global_points' (with near-duplicate clusters if they are collapsed)
+ * and its quantized copy if 'options' require it (then descriptors of catalog are paged),
+ * and store of 'user_points' queries.
+ */
+void BuildStores(const util::DataSetUnion &global_points, const util::DataSetUnion &user_points,
+                 const SearchOptions &options, FeatureStore **catalog, FeatureStore **queries,
+                 QuantizedStore **quantized) {
+  util::DataSetUnion points;
+  points.Add(global_points);
+  points.Add(user_points);
+  QStringList highlevel_names = HighlevelDescriptors(points);
+  *catalog = BuildFeatureStore(global_points, highlevel_names);
+  *queries = BuildFeatureStore(user_points, highlevel_names);
+  if ( options.collapse_duplicates ) {
+    ClusterDuplicates(*catalog);
+  }
+  *quantized = nullptr;
+  if ( options.quantization != QUANTIZATION_NONE ) {
+    *quantized = new QuantizedStore(**catalog, options.quantization, options.threads);
+    // full rows are read only by rerank
+    (*catalog)->PageDescriptors();
+  }
+}
+
+typedef std::function<void(const FeatureStore &catalog, const FeatureStore &queries,
+                           const vector<vector<Neighbour> > &result)> BlockHandler;
+
+/**
+ * SearchBlocks Searches similar points of 'catalog' for 'block' queries at once (all queries if 'block' is 0)
+ * and passes result of every block to 'handler' together with searched catalog and store of block queries.
+ * Points which are in any of queries or don't match filter aren't recommended.
+ */
+void SearchBlocks(const FeatureStore &catalog, const FeatureStore &queries, const QuantizedStore *quantized,
+                  const vector<const HnswIndex*> &indexes, const MetricWeights &weights,
+                  const SearchOptions &options, const MetadataIndex *metadata, int block,
+                  const BlockHandler &handler) {
+  size_t matching = 0;
+  vector<bool> exclude = Exclusion(catalog, queries, options, metadata, &matching);
+  SearchOptions search_options = options;
+  // approximate search of selective filters finds few matching candidates, they are searched exactly
+  const bool selective = matching < FILTER_PARTITION_FRACTION * catalog.Size();
+  if ( selective ) {
+    quantized = nullptr;
+  }
+  const vector<const HnswIndex*> no_indexes;
+  const vector<const HnswIndex*> &search_indexes = selective ? no_indexes : indexes;
+  bool approximate = quantized || !search_indexes.empty();
+  if ( approximate && !options.filter.Empty() ) {
+    // not matching rows are excluded from approximate search, which takes more candidates
+    // as some of them are filtered out
+    search_options.rerank = options.rerank * catalog.Size() / std::max<size_t>(1, matching);
+  }
+  if ( block <= 0 ) {
+    block = std::max(1, queries.Size());
+  }
+  float recall = 0.0;
+  for ( int first = 0; first < queries.Size(); first += block ) {
+    FeatureStore* part = nullptr;
+    if ( first > 0 || block < queries.Size() ) {
+      vector<int> rows;
+      for ( int q = first; q < std::min(first + block, queries.Size()); ++q ) {
+        rows.push_back(q);
+      }
+      part = Partition(queries, rows);
+    }
+    const FeatureStore &block_queries = part ? *part : queries;
+    vector<vector<Neighbour> > result = SearchQueries(catalog, quantized, search_indexes, block_queries, exclude,
+                                                      weights, search_options);
+    if ( approximate && options.report_recall ) {
+      vector<vector<Neighbour> > exact = BatchSearch(catalog, block_queries, AllRows(block_queries),
+                                                     options.quantity, weights, exclude, options.threads);
+      for ( int q = 0; q < block_queries.Size(); ++q ) {
+        recall += Recall(result[q], exact[q]);
+      }
+    }
+    handler(catalog, block_queries, result);
+    delete part;
+  }
+  if ( approximate && options.report_recall && queries.Size() > 0 ) {
+    std::cout << "Recall@" << options.quantity << " of approximate search: "
+              << recall / queries.Size() << std::endl;
+  }
+}
+
+}  // namespace
 
 types::audiq_similar FindSimilar(DataSet *global_dataset, DataSet *user_dataset,
-                                 const vector<float> &weights) {
-  gaia2::init();
-  QStringList user_points = user_dataset->pointNames();
-  DataSet* result_dataset = util::SumDataSets(global_dataset, user_dataset);
-  DistanceFunction* metric = CompressedDefaultMetric(result_dataset,
-                                                     weights.at(0), weights.at(1), weights.at(2));
-  return FindSimilar(result_dataset, user_points, metric);
-}
-
-types::audiq_similar FindSimilar(DataSet *dataset, const QStringList &user_points,
-                                 DistanceFunction *metric, int quantity) {
-  gaia2::View v = gaia2::View(dataset);
-  types::audiq_similar similar_samples;
-  vector<string> temporary;
-  int n = user_points.size();
-  for ( auto p : user_points ) {
-    temporary = vector<string>();
-    auto result = v.nnSearch(p, metric);
-    for ( auto pair : result.get(n + quantity) ) {
-      // take only global dataset samples, even if samples from user dataser are more similar.
-      if ( !user_points.contains(pair.first)) {
-        temporary.push_back(dataset->point(pair.first)
-                            ->label(FILENAME_DESCRIPTOR)
-                            .toSingleValue()
-                            .toStdString());
-        std::cout << pair.first.toStdString() << "   " << pair.second << std::endl;
+                                 const vector<float> &weights, const SearchOptions &options,
+                                 const vector<const HnswIndex*> &indexes) {
+  return FindSimilar(util::DataSetUnion({ global_dataset }), util::DataSetUnion({ user_dataset }),
+                     weights, options, indexes);
+}
+
+types::audiq_similar FindSimilar(const util::DataSetUnion &global_points, const util::DataSetUnion &user_points,
+                                 const vector<float> &weights, const SearchOptions &options,
+                                 const vector<const HnswIndex*> &indexes) {
+  FeatureStore* catalog = nullptr;
+  FeatureStore* queries = nullptr;
+  QuantizedStore* quantized = nullptr;
+  BuildStores(global_points, user_points, options, &catalog, &queries, &quantized);
+  types::audiq_similar similar_samples = FindSimilar(*catalog, *queries, quantized, indexes, weights, options);
+  delete quantized;
+  delete queries;
+  delete catalog;
+  return similar_samples;
+}
+
+void StreamSimilar(const util::DataSetUnion &global_points, const util::DataSetUnion &user_points,
+                   const vector<float> &weights, const SearchOptions &options,
+                   const vector<const HnswIndex*> &indexes, const RecommendationHandler &handler) {
+  FeatureStore* catalog = nullptr;
+  FeatureStore* queries = nullptr;
+  QuantizedStore* quantized = nullptr;
+  BuildStores(global_points, user_points, options, &catalog, &queries, &quantized);
+  StreamSimilar(*catalog, *queries, quantized, indexes, weights, options, handler);
+  delete quantized;
+  delete queries;
+  delete catalog;
+}
+
+types::audiq_similar FindSimilar(const FeatureStore &catalog, const FeatureStore &queries,
+                                 const QuantizedStore *quantized, const vector<const HnswIndex*> &indexes,
+                                 const vector<float> &weights, const SearchOptions &options) {
+  return SimilarNames(FindNeighbours(catalog, queries, quantized, indexes, weights, options));
+}
+
+types::audiq_neighbours FindNeighbours(const FeatureStore &catalog, const FeatureStore &queries,
+                                       const QuantizedStore *quantized, const vector<const HnswIndex*> &indexes,
+                                       const vector<float> &weights, const SearchOptions &options,
+                                       const MetadataIndex *metadata) {
+  types::audiq_neighbours neighbours;
+  SearchBlocks(catalog, queries, quantized, indexes, MetricWeights(weights), options, metadata, 0,
+               [&neighbours](const FeatureStore &searched, const FeatureStore &block,
+                             const vector<vector<Neighbour> > &result) {
+    neighbours = ToNeighbours(searched, block, result);
+  });
+  return neighbours;
+}
+
+void StreamSimilar(const FeatureStore &catalog, const FeatureStore &queries,
+                   const QuantizedStore *quantized, const vector<const HnswIndex*> &indexes,
+                   const vector<float> &weights, const SearchOptions &options,
+                   const RecommendationHandler &handler, const MetadataIndex *metadata) {
+  MetricWeights metric_weights(weights);
+  int block_size = std::max(STREAM_QUERIES, QUERY_TILE * util::ThreadsNumber(options.threads));
+  SearchBlocks(catalog, queries, quantized, indexes, metric_weights, options, metadata, block_size,
+               [&handler](const FeatureStore &searched, const FeatureStore &block,
+                          const vector<vector<Neighbour> > &result) {
+    for ( int q = 0; q < block.Size(); ++q ) {
+      vector<Recommendation> similar;
+      for ( const auto &n : result[q] ) {
+        Recommendation r;
+        r.file_name = searched.FileName(n.index);
+        r.distance = n.distance;
+        r.components = ComponentDistances(block, q, searched, n.index);
+        similar.push_back(r);
       }
+      handler(block.FileName(q), similar);
+    }
+  });
+}
+
+types::audiq_similar SimilarNames(const types::audiq_neighbours &neighbours) {
+  types::audiq_similar similar_samples;
+  for ( const auto &pair : neighbours ) {
+    vector<string> &similar = similar_samples[pair.first];
+    for ( const auto &n : pair.second ) {
+      similar.push_back(n.first);
     }
-    // take the most similar n samples
-    vector<string> similar(temporary.begin(), temporary.begin() + quantity);
-    similar_samples[dataset->point(p)
-                    ->label(FILENAME_DESCRIPTOR)
-                    .toSingleValue()
-                    .toStdString()] = similar;
   }
   return similar_samples;
 }
 
+vector<types::audiq_similar> FindSimilarSweep(const util::DataSetUnion &global_points,
+                                              const util::DataSetUnion &user_points,
+                                              const vector<vector<float> > &weights, const SearchOptions &options) {
+  util::DataSetUnion points;
+  points.Add(global_points);
+  points.Add(user_points);
+  QStringList highlevel_names = HighlevelDescriptors(points);
+  FeatureStore* catalog = BuildFeatureStore(global_points, highlevel_names);
+  FeatureStore* queries = BuildFeatureStore(user_points, highlevel_names);
+  if ( options.collapse_duplicates ) {
+    ClusterDuplicates(catalog);
+  }
+  vector<types::audiq_similar> similar_samples = FindSimilarSweep(*catalog, *queries, weights, options);
+  delete queries;
+  delete catalog;
+  return similar_samples;
+}
+
+vector<types::audiq_similar> FindSimilarSweep(const FeatureStore &catalog, const FeatureStore &queries,
+                                              const vector<vector<float> > &weights, const SearchOptions &options) {
+  vector<MetricWeights> metric_weights;
+  for ( const auto &w : weights ) {
+    metric_weights.push_back(MetricWeights(w));
+  }
+  vector<vector<vector<Neighbour> > > result = SweepSearch(catalog, queries, AllRows(queries), options.quantity,
+                                                           metric_weights, Exclusion(catalog, queries, options),
+                                                           options.threads);
+  vector<types::audiq_similar> similar_samples;
+  for ( const auto &r : result ) {
+    similar_samples.push_back(SimilarNames(ToNeighbours(catalog, queries, r)));
+  }
+  return similar_samples;
+}
+
+bool ValidateNativeMetric(DataSet *dataset, const vector<float> &weights, int pairs, float tolerance) {
+  return ValidateNativeMetric(dataset, vector<vector<float> >({ weights }), pairs, tolerance);
+}
+
+bool ValidateNativeMetric(DataSet *dataset, const vector<vector<float> > &weights, int pairs, float tolerance) {
+  if ( dataset->size() == 0 ) {
+    return true;
+  }
+  FeatureStore* store = BuildFeatureStore(dataset);
+  float error = 0.0;
+  for ( const auto &w : weights ) {
+    MetricWeights metric_weights(w);
+    std::unique_ptr<DistanceFunction> metric(CompressedDefaultMetric(dataset->layout(), metric_weights.pca,
+                                                                     metric_weights.mfcc, metric_weights.highlevel));
+    std::mt19937 generator(0);
+    std::uniform_int_distribution<int> row(0, store->Size() - 1);
+    for ( int k = 0; k < pairs; ++k ) {
+      int i = row(generator), j = row(generator);
+      float expected = (*metric)(*dataset->at(i), *dataset->at(j));
+      error = std::max(error, std::fabs(expected - Distance(*store, i, *store, j, metric_weights)));
+    }
+  }
+  std::cout << "Native metric (" << IsaName(ActiveKernels().isa) << ") max error against gaia2 on "
+            << pairs << " pairs";
+  if ( weights.size() > 1 ) {
+    std::cout << " of " << weights.size() << " weights";
+  }
+  std::cout << ": " << error << (error <= tolerance ? "" : " - exceeds tolerance") << std::endl;
+  delete store;
+  return error <= tolerance;
+}
+
 DistanceFunction* CompressedDefaultMetric(DataSet *dataset, float weight_pca,
                                           float weight_mfcc, float weight_highlevel) {
+  return CompressedDefaultMetric(dataset->layout(), weight_pca, weight_mfcc, weight_highlevel);
+}
+
+DistanceFunction* CompressedDefaultMetric(const PointLayout &layout, float weight_pca,
+                                          float weight_mfcc, float weight_highlevel) {
 
   ParameterMap pca;
   ParameterMap compressed_pca;
@@ -79,7 +419,7 @@ DistanceFunction* CompressedDefaultMetric(DataSet *dataset, float weight_pca,
   ParameterMap highlevel;
   ParameterMap compressed_highlevel;
   ParameterMap weights;
-  for ( auto d : dataset->layout().descriptorNames(gaia2::RealType, QStringList() << "highlevel.*.all.*") ) {
+  for ( auto d : layout.descriptorNames(gaia2::RealType, QStringList() << "highlevel.*.all.*") ) {
    weights.insert(d, 1.0);
   }
   ParameterMap params_highlevel;
@@ -96,11 +436,16 @@ DistanceFunction* CompressedDefaultMetric(DataSet *dataset, float weight_pca,
   composite_params.insert("compressed_kullback_leibner_mfcc", mfcc);
   composite_params.insert("compressed_weighted_pearson_highlevel", highlevel);
   //
-  return gaia2::MetricFactory::create("LinearCombination", dataset->layout(), composite_params);
+  return gaia2::MetricFactory::create("LinearCombination", layout, composite_params);
 }
 
 DistanceFunction* DefaultMetric(DataSet *dataset, float weight_pca,
                                 float weight_mfcc, float weight_highlevel) {
+  return DefaultMetric(dataset->layout(), weight_pca, weight_mfcc, weight_highlevel);
+}
+
+DistanceFunction* DefaultMetric(const PointLayout &layout, float weight_pca,
+                                float weight_mfcc, float weight_highlevel) {
   ParameterMap pca;
   ParameterMap params_pca;
   params_pca.insert("descriptorNames", "pca");
@@ -117,7 +462,7 @@ DistanceFunction* DefaultMetric(DataSet *dataset, float weight_pca,
   //
   ParameterMap highlevel;
   ParameterMap weights;
-  for ( auto d : dataset->layout().descriptorNames(gaia2::RealType, QStringList() << "highlevel.*.all.*") ) {
+  for ( auto d : layout.descriptorNames(gaia2::RealType, QStringList() << "highlevel.*.all.*") ) {
     weights.insert(d, 1.0);
   }
   ParameterMap params_highlevel;
@@ -132,7 +477,7 @@ DistanceFunction* DefaultMetric(DataSet *dataset, float weight_pca,
   composite_params.insert("weighted_pearson_highlevel", highlevel);
   //
 
-  return gaia2::MetricFactory::create("LinearCombination", dataset->layout(), composite_params);
+  return gaia2::MetricFactory::create("LinearCombination", layout, composite_params);
 }
 
 
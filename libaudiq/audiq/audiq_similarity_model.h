@@ -2,38 +2,140 @@
 #define PROJECT_AUDIQ_SIMILARITY_MODEL_H
 #include <string>
 #include <vector>
+#include <functional>
 #include <QStringList>
 #include "gaia2/dataset.h"
 #include "gaia2/parameter.h"
 #include "audiq/audiq_types.h"
 #include "audiq/audiq_config.h"
+#include "audiq/audiq_search_options.h"
+#include "audiq/audiq_dataset_union.h"
+#include "audiq/audiq_feature_store.h"
+#include "audiq/audiq_native_metric.h"
+
+// minimal number of queries searched at once by StreamSimilar, result of every block of queries
+// is handed out before the next block is searched
+#define STREAM_QUERIES 256
 
 namespace audiq {
 namespace similarity {
 
 using gaia2::DataSet;
+using gaia2::PointLayout;
 using gaia2::ParameterMap;
 using gaia2::DistanceFunction;
 
-types::audiq_similar FindSimilar(DataSet *global_dataset, DataSet *user_dataset, const vector<float> &weights);
+class HnswIndex;
+class QuantizedStore;
+class MetadataIndex;
+
 /**
- * @brief FindSimilar Find 'quantity' the most similar samples in the 'audiq_dataset' for samples from 'user_dataset'
- * @param global_dataset DataSet where Audiq samples stored.
- * @param user_points Samples id's for which is need to find similar. This id's must be in 'global_dataset'.
- * @param metric Metric used for similarity measure.
- * @param quantity Number of the most similar samples to return.
- * @return map with user samples names and corresponding to them the most similar samples from 'audiq_dataset'.
- * @note Function find the most similar samples in 'global_dataset' and return samples from it
- *  even if there are some samples in 'user_dataset' which more similar.
- * The original 'global_dataset' is deleted during function work (because of high memory usage).
+ * @brief FindSimilar Finds 'options.quantity' similar samples of 'global_dataset' for all samples of 'user_dataset'.
+ * Only global points are searched, user points are queries; samples which are in both datasets aren't recommended.
+ * @param indexes HNSW indexes of global dataset, used if 'options.index' is set.
  */
-types::audiq_similar FindSimilar(DataSet *dataset, const QStringList &user_points,
-                                         DistanceFunction *metric, int quantity = QUANTITY);
+types::audiq_similar FindSimilar(DataSet *global_dataset, DataSet *user_dataset, const vector<float> &weights,
+                                 const SearchOptions &options = SearchOptions(),
+                                 const vector<const HnswIndex*> &indexes = vector<const HnswIndex*>());
+/**
+ * @brief FindSimilar Same as FindSimilar for datasets, but for points of several datasets,
+ * which are searched in place, without merging datasets together.
+ */
+types::audiq_similar FindSimilar(const util::DataSetUnion &global_points, const util::DataSetUnion &user_points,
+                                 const vector<float> &weights, const SearchOptions &options = SearchOptions(),
+                                 const vector<const HnswIndex*> &indexes = vector<const HnswIndex*>());
+
+/**
+ * @brief FindSimilar Finds 'options.quantity' similar points of 'catalog' for every point of 'queries'
+ * (stores must have the same highlevel names). Points of catalog which are in queries too aren't recommended.
+ * @param quantized Quantized copy of 'catalog' or nullptr.
+ */
+types::audiq_similar FindSimilar(const FeatureStore &catalog, const FeatureStore &queries,
+                                 const QuantizedStore *quantized, const vector<const HnswIndex*> &indexes,
+                                 const vector<float> &weights, const SearchOptions &options);
+/**
+ * @brief FindNeighbours Same as FindSimilar for stores, but returns distances of similar samples too.
+ * @param metadata Index of 'catalog' metadata used to find rows matching 'options.filter',
+ * if it's nullptr catalog is scanned.
+ */
+types::audiq_neighbours FindNeighbours(const FeatureStore &catalog, const FeatureStore &queries,
+                                       const QuantizedStore *quantized, const vector<const HnswIndex*> &indexes,
+                                       const vector<float> &weights, const SearchOptions &options,
+                                       const MetadataIndex *metadata = nullptr);
+/**
+ * @brief Recommendation Similar sample with its distance and compressed distances of metric components.
+ */
+struct Recommendation {
+  std::string file_name;
+  float distance;
+  Components components;
+};
+
+/**
+ * @brief RecommendationHandler Receives similar samples of 'target' sample as soon as they are found.
+ * Handler is called from one thread at a time per StreamSimilar call.
+ */
+typedef std::function<void(const std::string &target, const vector<Recommendation> &similar)> RecommendationHandler;
+
+/**
+ * @brief StreamSimilar Same as FindNeighbours, but queries are searched by blocks (see STREAM_QUERIES) and
+ * similar samples of every query are passed to 'handler' as soon as its block is searched,
+ * so result isn't accumulated in memory.
+ */
+void StreamSimilar(const FeatureStore &catalog, const FeatureStore &queries,
+                   const QuantizedStore *quantized, const vector<const HnswIndex*> &indexes,
+                   const vector<float> &weights, const SearchOptions &options,
+                   const RecommendationHandler &handler, const MetadataIndex *metadata = nullptr);
+/**
+ * @brief StreamSimilar Same as FindSimilar for points of several datasets, but with 'handler' (see above).
+ */
+void StreamSimilar(const util::DataSetUnion &global_points, const util::DataSetUnion &user_points,
+                   const vector<float> &weights, const SearchOptions &options,
+                   const vector<const HnswIndex*> &indexes, const RecommendationHandler &handler);
+
+/**
+ * @brief SimilarNames Drops distances of 'neighbours'.
+ */
+types::audiq_similar SimilarNames(const types::audiq_neighbours &neighbours);
+
+/**
+ * @brief FindSimilarSweep Same as FindSimilar, but for every weights triple of 'weights':
+ * component distances of each pair of points are computed once and combined with all triples.
+ * Search is always exact (quantization and index options are ignored).
+ * @return Similar samples for every triple, in order of 'weights'.
+ */
+vector<types::audiq_similar> FindSimilarSweep(const util::DataSetUnion &global_points,
+                                              const util::DataSetUnion &user_points,
+                                              const vector<vector<float> > &weights,
+                                              const SearchOptions &options = SearchOptions());
+vector<types::audiq_similar> FindSimilarSweep(const FeatureStore &catalog, const FeatureStore &queries,
+                                              const vector<vector<float> > &weights, const SearchOptions &options);
+
+/**
+ * @brief ValidateNativeMetric Compares native metric (with active SIMD kernels) against CompressedDefaultMetric
+ * on 'pairs' random pairs of 'dataset' points and prints max absolute error.
+ * @return true if error is within 'tolerance'.
+ */
+bool ValidateNativeMetric(DataSet *dataset, const vector<float> &weights,
+                          int pairs = VALIDATION_PAIRS, float tolerance = VALIDATION_TOLERANCE);
+/**
+ * @brief ValidateNativeMetric Same as above for every weights triple of 'weights' (e.g. of a sweep),
+ * store of 'dataset' is built once.
+ */
+bool ValidateNativeMetric(DataSet *dataset, const vector<vector<float> > &weights,
+                          int pairs = VALIDATION_PAIRS, float tolerance = VALIDATION_TOLERANCE);
 
 DistanceFunction* CompressedDefaultMetric(DataSet *dataset, float weight_pca, float weight_mfcc, float weight_highlevel);
+/**
+ * @brief CompressedDefaultMetric Same as above for points of 'layout'.
+ */
+DistanceFunction* CompressedDefaultMetric(const PointLayout &layout, float weight_pca, float weight_mfcc,
+                                          float weight_highlevel);
 
 DistanceFunction* DefaultMetric(DataSet *dataset, float weight_pca, float weight_mfcc, float weight_highlevel);
 
+DistanceFunction* DefaultMetric(const PointLayout &layout, float weight_pca, float weight_mfcc, float weight_highlevel);
+
 }  // namespace similarity
 }  // namespace audiq
 #endif  // PROJECT_AUDIQ_SIMILARITY_MODEL_H
@@ -0,0 +1,502 @@
+#include "audiq/audiq_streaming_build.h"
+#include <cmath>
+#include <limits>
+#include <random>
+#include <fstream>
+#include <numeric>
+#include <algorithm>
+#include "gaia2/gaia.h"
+#include "audiq/audiq_util.h"
+#include "audiq/audiq_binary_io.h"
+
+#define PCA_PROJECTION_MAGIC   "AQPC"
+#define PCA_PROJECTION_VERSION 1
+#define EIGEN_MAX_ITERATIONS   300
+#define EIGEN_TOLERANCE        1e-10
+#define EIGEN_OVERSAMPLING     10
+
+namespace audiq {
+namespace util {
+
+namespace {
+
+typedef vector<vector<double> > Vectors;
+
+double Dot(const vector<double> &a, const vector<double> &b) {
+  return std::inner_product(a.begin(), a.end(), b.begin(), 0.0);
+}
+
+// Modified Gram-Schmidt, applied twice for numerical stability
+void Orthonormalize(Vectors *vectors) {
+  for ( int pass = 0; pass < 2; ++pass ) {
+    for ( size_t i = 0; i < vectors->size(); ++i ) {
+      vector<double> &v = (*vectors)[i];
+      for ( size_t j = 0; j < i; ++j ) {
+        double projection = Dot(v, (*vectors)[j]);
+        for ( size_t d = 0; d < v.size(); ++d ) {
+          v[d] -= projection * (*vectors)[j][d];
+        }
+      }
+      double norm = std::sqrt(Dot(v, v));
+      if ( norm > 0.0 ) {
+        for ( auto &x : v ) {
+          x /= norm;
+        }
+      }
+    }
+  }
+}
+
+Vectors Multiply(const vector<double> &matrix, int dimension, const Vectors &vectors) {
+  Vectors result(vectors.size(), vector<double>(dimension, 0.0));
+  for ( int r = 0; r < dimension; ++r ) {
+    const double* row = &matrix[static_cast<size_t>(r) * dimension];
+    for ( size_t i = 0; i < vectors.size(); ++i ) {
+      result[i][r] = std::inner_product(row, row + dimension, vectors[i].begin(), 0.0);
+    }
+  }
+  return result;
+}
+
+// Cyclic Jacobi eigenvalue algorithm for small symmetric 'n' x 'n' matrix 'a',
+// columns of 'v' become eigenvectors, diagonal of 'a' - eigenvalues.
+void Jacobi(vector<double> *a, vector<double> *v, int n) {
+  vector<double> &m = *a;
+  v->assign(n * n, 0.0);
+  for ( int i = 0; i < n; ++i ) {
+    (*v)[i * n + i] = 1.0;
+  }
+  for ( int sweep = 0; sweep < 100; ++sweep ) {
+    double off = 0.0;
+    for ( int p = 0; p < n; ++p ) {
+      for ( int q = p + 1; q < n; ++q ) {
+        off += m[p * n + q] * m[p * n + q];
+      }
+    }
+    if ( off < 1e-30 ) {
+      return;
+    }
+    for ( int p = 0; p < n; ++p ) {
+      for ( int q = p + 1; q < n; ++q ) {
+        if ( m[p * n + q] == 0.0 ) {
+          continue;
+        }
+        double theta = (m[q * n + q] - m[p * n + p]) / (2.0 * m[p * n + q]);
+        double t = (theta >= 0 ? 1.0 : -1.0) / (std::fabs(theta) + std::sqrt(theta * theta + 1.0));
+        double c = 1.0 / std::sqrt(t * t + 1.0);
+        double s = t * c;
+        for ( int k = 0; k < n; ++k ) {
+          double kp = m[k * n + p], kq = m[k * n + q];
+          m[k * n + p] = c * kp - s * kq;
+          m[k * n + q] = s * kp + c * kq;
+        }
+        for ( int k = 0; k < n; ++k ) {
+          double pk = m[p * n + k], qk = m[q * n + k];
+          m[p * n + k] = c * pk - s * qk;
+          m[q * n + k] = s * pk + c * qk;
+        }
+        for ( int k = 0; k < n; ++k ) {
+          double kp = (*v)[k * n + p], kq = (*v)[k * n + q];
+          (*v)[k * n + p] = c * kp - s * kq;
+          (*v)[k * n + q] = s * kp + c * kq;
+        }
+      }
+    }
+  }
+}
+
+vector<string> SigFiles(const string &directory) {
+  vector<string> files;
+  for ( auto& p : filesystem::recursive_directory_iterator(directory) ) {
+    if ( p.path().extension() == ".sig" ) {
+      files.push_back(p.path().string());
+    }
+  }
+  std::sort(files.begin(), files.end());
+  return files;
+}
+
+string PointName(const string &file_name) {
+  return filesystem::path(file_name).stem().string();
+}
+
+}  // namespace
+
+CovarianceAccumulator::CovarianceAccumulator(int dimension)
+    : _dimension(dimension),
+      _count(0),
+      _mean(dimension, 0.0),
+      _delta(dimension, 0.0),
+      _comoment(static_cast<size_t>(dimension) * (dimension + 1) / 2, 0.0) {}
+
+void CovarianceAccumulator::Add(const vector<double> &x) {
+  ++_count;
+  for ( int i = 0; i < _dimension; ++i ) {
+    _delta[i] = x[i] - _mean[i];
+    _mean[i] += _delta[i] / _count;
+  }
+  // C += (x - old_mean) * (x - new_mean)^T
+  size_t k = 0;
+  for ( int i = 0; i < _dimension; ++i ) {
+    const double delta = _delta[i];
+    for ( int j = i; j < _dimension; ++j ) {
+      _comoment[k++] += delta * (x[j] - _mean[j]);
+    }
+  }
+}
+
+vector<double> CovarianceAccumulator::Covariance() const {
+  vector<double> covariance(static_cast<size_t>(_dimension) * _dimension, 0.0);
+  const double n = std::max(1L, _count - 1);
+  size_t k = 0;
+  for ( int i = 0; i < _dimension; ++i ) {
+    for ( int j = i; j < _dimension; ++j ) {
+      covariance[static_cast<size_t>(i) * _dimension + j] = _comoment[k] / n;
+      covariance[static_cast<size_t>(j) * _dimension + i] = _comoment[k] / n;
+      ++k;
+    }
+  }
+  return covariance;
+}
+
+vector<double> TopEigenvectors(const vector<double> &matrix, int dimension, int k,
+                               vector<double> *eigenvalues) {
+  k = std::min(k, dimension);
+  int p = std::min(dimension, k + EIGEN_OVERSAMPLING);
+  std::mt19937 generator(0);
+  std::normal_distribution<double> normal;
+  Vectors q(p, vector<double>(dimension));
+  for ( auto &v : q ) {
+    for ( auto &x : v ) {
+      x = normal(generator);
+    }
+  }
+  Orthonormalize(&q);
+  vector<double> previous(p, 0.0);
+  for ( int iteration = 0; iteration < EIGEN_MAX_ITERATIONS; ++iteration ) {
+    Vectors z = Multiply(matrix, dimension, q);
+    double change = 0.0;
+    for ( int i = 0; i < k; ++i ) {
+      double rayleigh = Dot(q[i], z[i]);
+      change = std::max(change, std::fabs(rayleigh - previous[i]) / std::max(std::fabs(rayleigh), 1e-30));
+      previous[i] = rayleigh;
+    }
+    q.swap(z);
+    Orthonormalize(&q);
+    if ( change < EIGEN_TOLERANCE ) {
+      break;
+    }
+  }
+  // Rayleigh-Ritz: eigenvectors of projection of 'matrix' to the found subspace
+  Vectors z = Multiply(matrix, dimension, q);
+  vector<double> t(p * p), w;
+  for ( int i = 0; i < p; ++i ) {
+    for ( int j = 0; j < p; ++j ) {
+      t[i * p + j] = Dot(q[i], z[j]);
+    }
+  }
+  Jacobi(&t, &w, p);
+  vector<int> order(p);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](int a, int b) { return t[a * p + a] > t[b * p + b]; });
+  vector<double> result(static_cast<size_t>(k) * dimension, 0.0);
+  if ( eigenvalues ) {
+    eigenvalues->clear();
+  }
+  for ( int c = 0; c < k; ++c ) {
+    int e = order[c];
+    for ( int i = 0; i < p; ++i ) {
+      for ( int d = 0; d < dimension; ++d ) {
+        result[static_cast<size_t>(c) * dimension + d] += w[i * p + e] * q[i][d];
+      }
+    }
+    if ( eigenvalues ) {
+      eigenvalues->push_back(t[e * p + e]);
+    }
+  }
+  return result;
+}
+
+PcaProjection::PcaProjection(const QStringList &names, const vector<int> &dimensions,
+                             const vector<double> &mean, const vector<double> &components)
+    : _names(names), _dimensions(dimensions), _mean(mean), _components(components) {}
+
+int PcaProjection::OutputDimension() const {
+  return _mean.empty() ? 0 : static_cast<int>(_components.size() / _mean.size());
+}
+
+bool PcaProjection::Gather(const Point *point, vector<double> *values) const {
+  values->clear();
+  for ( int n = 0; n < _names.size(); ++n ) {
+    gaia2::RealDescriptor value = point->value(_names.at(n));
+    if ( static_cast<int>(value.size()) != _dimensions[n] ) {
+      return false;
+    }
+    values->insert(values->end(), value.begin(), value.end());
+  }
+  return true;
+}
+
+bool PcaProjection::Project(const Point *point, float *pca) const {
+  vector<double> values;
+  if ( !Gather(point, &values) ) {
+    return false;
+  }
+  const int dimension = InputDimension();
+  for ( int c = 0; c < OutputDimension(); ++c ) {
+    const double* component = &_components[static_cast<size_t>(c) * dimension];
+    double sum = 0.0;
+    for ( int d = 0; d < dimension; ++d ) {
+      sum += (values[d] - _mean[d]) * component[d];
+    }
+    pca[c] = sum;
+  }
+  return true;
+}
+
+bool PcaProjection::Save(const string &file_name) const {
+  std::ofstream out(file_name, std::ios::binary);
+  WriteHeader(out, PCA_PROJECTION_MAGIC, PCA_PROJECTION_VERSION);
+  WriteValue<int32_t>(out, _names.size());
+  for ( int n = 0; n < _names.size(); ++n ) {
+    WriteString(out, _names.at(n).toStdString());
+  }
+  WriteVector(out, _dimensions);
+  WriteVector(out, _mean);
+  WriteVector(out, _components);
+  return static_cast<bool>(out);
+}
+
+bool PcaProjection::Load(const string &file_name) {
+  std::ifstream in(file_name, std::ios::binary);
+  int32_t size;
+  if ( !ReadHeader(in, PCA_PROJECTION_MAGIC, PCA_PROJECTION_VERSION) || !ReadValue(in, &size) ) {
+    return false;
+  }
+  _names.clear();
+  string name;
+  for ( int n = 0; n < size; ++n ) {
+    if ( !ReadString(in, &name) ) {
+      return false;
+    }
+    _names << QString::fromStdString(name);
+  }
+  return ReadVector(in, &_dimensions) && ReadVector(in, &_mean) && ReadVector(in, &_components);
+}
+
+StreamingDataSetBuilder::StreamingDataSetBuilder(size_t memory_budget)
+    : _memory_budget(memory_budget << 20) {}
+
+vector<vector<string> > StreamingDataSetBuilder::Chunks(const vector<string> &files) const {
+  vector<vector<string> > chunks(1);
+  size_t chunk_bytes = 0;
+  for ( const auto &f : files ) {
+    size_t bytes = filesystem::file_size(f) * POINT_MEMORY_FACTOR;
+    if ( !chunks.back().empty() && chunk_bytes + bytes > _memory_budget ) {
+      chunks.push_back(vector<string>());
+      chunk_bytes = 0;
+    }
+    chunks.back().push_back(f);
+    chunk_bytes += bytes;
+  }
+  return chunks;
+}
+
+DataSet* StreamingDataSetBuilder::LoadChunk(const vector<string> &files) const {
+  QVector<Point*> points;
+  for ( const auto &f : files ) {
+    points << LoadPoint(f, PointName(f));
+  }
+  DataSet* dataset = new DataSet;
+  dataset->addPoints(points);
+  for ( auto p : points ) {
+    delete p;
+  }
+  return dataset;
+}
+
+vector<Point*> StreamingDataSetBuilder::MapChunk(const vector<string> &files, const TransfoChain &history,
+                                                 vector<float> *durations) const {
+  vector<Point*> mapped;
+  for ( const auto &f : files ) {
+    Point* point = LoadPoint(f, PointName(f));
+    try {
+      mapped.push_back(history.mapPoint(point));
+      // duration is normalized by history, so it's taken from loaded point
+      if ( durations ) {
+        durations->push_back(similarity::PointDuration(point));
+      }
+    }
+    catch ( std::exception &e ) {
+      std::cout << f << ": " << e.what() << std::endl;
+    }
+    delete point;
+  }
+  return mapped;
+}
+
+bool StreamingDataSetBuilder::FitPreprocessing(const vector<string> &files, TransfoChain *history) const {
+  // normalization is fitted on a random sample of points, which fits in memory budget
+  vector<string> shuffled(files);
+  std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(0));
+  vector<string> sample = Chunks(shuffled).front();
+  DataSet* dataset = LoadChunk(sample);
+  DataSet* normalized = NormalizeDataSet(dataset);
+  delete dataset;
+  *history = normalized->history();
+  delete normalized;
+  return !history->empty();
+}
+
+bool StreamingDataSetBuilder::Build(const vector<string> &files, const string &dataset_name) {
+  if ( files.empty() ) {
+    return false;
+  }
+  InitGaia();
+  TransfoChain history;
+  if ( !FitPreprocessing(files, &history) ) {
+    return false;
+  }
+  history.save(QString::fromStdString(dataset_name + ".history"));
+  vector<vector<string> > chunks = Chunks(files);
+
+  // the first pass: accumulate covariance of descriptors used for PCA
+  QStringList names;
+  vector<int> dimensions;
+  CovarianceAccumulator accumulator;
+  PcaProjection layout;
+  vector<double> values;
+  for ( const auto &chunk : chunks ) {
+    for ( auto point : MapChunk(chunk, history) ) {
+      if ( names.empty() ) {
+        names = point->layout().descriptorNames(gaia2::RealType, QStringList() << "*",
+                                                QStringList() << "lowlevel.mfcc*" << "highlevel*");
+        for ( int n = 0; n < names.size(); ++n ) {
+          dimensions.push_back(point->value(names.at(n)).size());
+        }
+        layout = PcaProjection(names, dimensions, vector<double>(std::accumulate(dimensions.begin(),
+                                                                                 dimensions.end(), 0)),
+                               vector<double>());
+        accumulator = CovarianceAccumulator(layout.InputDimension());
+        std::cout << "PCA input dimension: " << layout.InputDimension() << ", covariance: "
+                  << (sizeof(double) * layout.InputDimension() * layout.InputDimension() >> 20)
+                  << " MB" << std::endl;
+      }
+      if ( layout.Gather(point, &values) ) {
+        accumulator.Add(values);
+      }
+      delete point;
+    }
+  }
+  if ( accumulator.Count() == 0 ) {
+    return false;
+  }
+  vector<double> components = TopEigenvectors(accumulator.Covariance(), accumulator.Dimension(),
+                                              PCA_DIMENSION);
+  PcaProjection projection(names, dimensions, accumulator.Mean(), components);
+  projection.Save(dataset_name + ".pca");
+
+  // the second pass: project points and save them chunk by chunk
+  std::ofstream segments(dataset_name + ".segments");
+  float pca[PCA_DIMENSION] = { 0 };
+  QStringList highlevel_names;
+  for ( size_t c = 0; c < chunks.size(); ++c ) {
+    vector<float> durations;
+    vector<Point*> points = MapChunk(chunks[c], history, &durations);
+    if ( highlevel_names.empty() && !points.empty() ) {
+      highlevel_names = points[0]->layout().descriptorNames(gaia2::RealType,
+                                                            QStringList() << HIGHLEVEL_PROBABILITIES);
+    }
+    FeatureStore store(points.size(), highlevel_names);
+    int row = 0;
+    for ( size_t p = 0; p < points.size(); ++p ) {
+      if ( projection.Project(points[p], pca) ) {
+        store.SetPoint(row, points[p], pca);
+        store.SetDuration(row++, durations[p]);
+      }
+      delete points[p];
+    }
+    if ( row != store.Size() ) {
+      // some points were skipped, keep only projected rows
+      FeatureStore projected(row, highlevel_names);
+      for ( int i = 0; i < row; ++i ) {
+        projected.CopyRow(i, store, i);
+      }
+      store = std::move(projected);
+    }
+    string segment = dataset_name + "." + std::to_string(c) + ".fst";
+    if ( !similarity::SaveFeatureStore(store, segment) ) {
+      return false;
+    }
+    segments << filesystem::path(segment).filename().string() << std::endl;
+  }
+  return static_cast<bool>(segments);
+}
+
+void StreamingBuildDataSets(const string &files_directory, const string &dataset_name,
+                            size_t memory_budget) {
+  InitGaia();
+  // points are loaded one by one to find out their types
+  map<string, vector<string> > files;
+  for ( const auto &f : SigFiles(files_directory) ) {
+    Point* point = LoadPoint(f, PointName(f));
+    files[point->label(TYPE_DESCRIPTOR).toSingleValue().toStdString()].push_back(f);
+    delete point;
+  }
+  StreamingDataSetBuilder builder(memory_budget);
+  for ( auto t : types::TYPES ) {
+    if ( !files[t].empty() && !builder.Build(files[t], dataset_name + "_" + t) ) {
+      std::cout << "Can't build dataset " << dataset_name + "_" + t << std::endl;
+    }
+  }
+}
+
+FeatureStore* LoadSegmentedDataSet(const string &dataset_name) {
+  std::ifstream segments_list(dataset_name + ".segments");
+  if ( !segments_list ) {
+    return nullptr;
+  }
+  filesystem::path directory = filesystem::path(dataset_name).parent_path();
+  vector<string> segments;
+  string segment;
+  while ( std::getline(segments_list, segment) ) {
+    if ( !segment.empty() ) {
+      segments.push_back((directory / segment).string());
+    }
+  }
+  // sizes are read from headers first, then segments are loaded one by one and copied to the result,
+  // so only one segment is in memory besides the result
+  int size = 0, segment_size;
+  QStringList highlevel_names, segment_names;
+  for ( size_t i = 0; i < segments.size(); ++i ) {
+    if ( !similarity::ReadFeatureStoreHeader(segments[i], &segment_size, &segment_names)
+         || (i > 0 && segment_names != highlevel_names)
+         || segment_size > std::numeric_limits<int>::max() - size ) {
+      return nullptr;
+    }
+    highlevel_names = segment_names;
+    size += segment_size;
+  }
+  FeatureStore* result = new FeatureStore(size, highlevel_names);
+  int row = 0;
+  for ( const auto &s : segments ) {
+    const FeatureStore* store = similarity::LoadFeatureStore(s);
+    if ( !store || row + store->Size() > size ) {
+      delete store;
+      delete result;
+      return nullptr;
+    }
+    for ( int j = 0; j < store->Size(); ++j ) {
+      result->CopyRow(row++, *store, j);
+    }
+    delete store;
+  }
+  if ( row != size ) {
+    delete result;
+    return nullptr;
+  }
+  return result;
+}
+
+}  // namespace util
+}  // namespace audiq
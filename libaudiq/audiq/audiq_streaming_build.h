@@ -0,0 +1,131 @@
+#ifndef PROJECT_AUDIQ_STREAMING_BUILD_H
+#define PROJECT_AUDIQ_STREAMING_BUILD_H
+
+#include <string>
+#include <vector>
+#include <QStringList>
+#include "gaia2/point.h"
+#include "gaia2/dataset.h"
+#include "gaia2/transformation.h"
+#include "audiq/audiq_types.h"
+#include "audiq/audiq_config.h"
+#include "audiq/audiq_feature_store.h"
+
+// default memory budget of streaming build, MB
+#define STREAMING_MEMORY_BUDGET 4096
+// approximate size of loaded (and transformed) point relative to its '.sig' file size
+#define POINT_MEMORY_FACTOR     4
+
+namespace audiq {
+namespace util {
+
+using gaia2::Point;
+using gaia2::DataSet;
+using gaia2::TransfoChain;
+using similarity::FeatureStore;
+
+/**
+ * @brief CovarianceAccumulator Incremental (one pass, Welford) mean and covariance of vectors.
+ */
+class CovarianceAccumulator {
+ public:
+  explicit CovarianceAccumulator(int dimension = 0);
+  void Add(const vector<double> &x);
+  long Count() const { return _count; }
+  int Dimension() const { return _dimension; }
+  const vector<double>& Mean() const { return _mean; }
+  /**
+   * Covariance Returns full 'Dimension()' x 'Dimension()' (row-major) sample covariance matrix.
+   */
+  vector<double> Covariance() const;
+
+ private:
+  int _dimension;
+  long _count;
+  vector<double> _mean;
+  vector<double> _delta;
+  // upper triangle of co-moment matrix
+  vector<double> _comoment;
+};
+
+/**
+ * @brief TopEigenvectors Finds 'k' eigenvectors of symmetric 'matrix' with the largest eigenvalues
+ * (subspace iteration with Rayleigh-Ritz step).
+ * @return 'k' x 'dimension' row-major matrix of eigenvectors, sorted by eigenvalue descending.
+ */
+vector<double> TopEigenvectors(const vector<double> &matrix, int dimension, int k,
+                               vector<double> *eigenvalues = nullptr);
+
+/**
+ * @brief PcaProjection Principal components of normalized descriptors, fitted by StreamingDataSetBuilder.
+ */
+class PcaProjection {
+ public:
+  PcaProjection() {}
+  PcaProjection(const QStringList &names, const vector<int> &dimensions,
+                const vector<double> &mean, const vector<double> &components);
+  /**
+   * Gather Concatenates values of projected descriptors of 'point', returns false if point doesn't have them.
+   */
+  bool Gather(const Point *point, vector<double> *values) const;
+  /**
+   * Project Writes 'OutputDimension()' principal components of 'point' to 'pca'.
+   */
+  bool Project(const Point *point, float *pca) const;
+  int InputDimension() const { return static_cast<int>(_mean.size()); }
+  int OutputDimension() const;
+  bool Save(const string &file_name) const;
+  bool Load(const string &file_name);
+
+ private:
+  QStringList _names;
+  vector<int> _dimensions;
+  vector<double> _mean;
+  vector<double> _components;
+};
+
+/**
+ * @brief StreamingDataSetBuilder Builds segmented dataset from '.sig' files, which don't fit in memory.
+ * Result of Build with 'dataset_name':
+ *  - dataset_name.history   gaia2 transformations preparing points for PCA (fitted on a random sample);
+ *  - dataset_name.pca       PCA fitted on all points with incremental covariance accumulation;
+ *  - dataset_name.N.fst     feature store segments (see similarity::SaveFeatureStore);
+ *  - dataset_name.segments  list of segments.
+ * Points are loaded and transformed in chunks, so peak memory is bounded by 'memory_budget' plus
+ * covariance matrix of normalized descriptors.
+ */
+class StreamingDataSetBuilder {
+ public:
+  /**
+   * @param memory_budget Memory for loaded points, MB.
+   */
+  explicit StreamingDataSetBuilder(size_t memory_budget = STREAMING_MEMORY_BUDGET);
+  /**
+   * Build Builds dataset 'dataset_name' from '.sig' 'files' of one samples type. Returns false on failure.
+   */
+  bool Build(const vector<string> &files, const string &dataset_name);
+
+ private:
+  vector<vector<string> > Chunks(const vector<string> &files) const;
+  DataSet* LoadChunk(const vector<string> &files) const;
+  vector<Point*> MapChunk(const vector<string> &files, const TransfoChain &history,
+                          vector<float> *durations = nullptr) const;
+  bool FitPreprocessing(const vector<string> &files, TransfoChain *history) const;
+
+  size_t _memory_budget;
+};
+
+/**
+ * @brief StreamingBuildDataSets Builds segmented datasets 'dataset_name'_TYPE from '.sig' files of 'files_directory'.
+ */
+void StreamingBuildDataSets(const string &files_directory, const string &dataset_name,
+                            size_t memory_budget = STREAMING_MEMORY_BUDGET);
+/**
+ * @brief LoadSegmentedDataSet Loads all segments of dataset built by StreamingDataSetBuilder as one store,
+ * segments are appended to it one by one. Returns nullptr if there is no such dataset.
+ */
+FeatureStore* LoadSegmentedDataSet(const string &dataset_name);
+
+}  // namespace util
+}  // namespace audiq
+#endif  // PROJECT_AUDIQ_STREAMING_BUILD_H
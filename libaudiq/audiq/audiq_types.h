@@ -3,6 +3,7 @@
 
 #include <map>
 #include <string>
+#include <utility>
 #include <vector>
 #include <iostream>
 #include <experimental/filesystem>
@@ -22,6 +23,8 @@ namespace filesystem = std::experimental::filesystem;
 namespace types {
 
 typedef std::map<std::string, std::vector<std::string> > audiq_similar;
+// the same as audiq_similar, but with distance of every similar sample
+typedef std::map<std::string, std::vector<std::pair<std::string, float> > > audiq_neighbours;
 static const std::vector<std::string> TYPES = { TYPE_PERCUSSION, TYPE_VOCAL, TYPE_MELODY };
 
 }  // namespace types
@@ -1,9 +1,17 @@
 #include "audiq/audiq_util.h"
 #include <map>
+#include <mutex>
+#include <memory>
+#include <exception>
+#include <atomic>
+#include <thread>
+#include <utility>
 #include <algorithm>
+#include "gaia2/gaia.h"
 #include "gaia2/utils.h"
 #include "audiq/audiq_config.h"
 #include "audiq/audiq_types.h"
+#include "audiq/audiq_concurrency.h"
 
 namespace audiq {
 namespace util {
@@ -33,45 +41,160 @@ void ConcatenateDataSets(const string &datasets_directory, const string &dataset
     ds.save(QString::fromStdString(dataset_name + ".db"));
 }
 
+void InitGaia() {
+  static std::once_flag flag;
+  std::call_once(flag, [] { gaia2::init(); });
+}
+
 void MergeFiles(const string &files_directory, const string &datasets_directory,
-                const string &dataset_name, const int n) {
+                const string &dataset_name, const int n, int threads) {
+  InitGaia();
   ReCreateDirs(datasets_directory);
-  string name;
-  string type;
+  threads = ThreadsNumber(threads);
+  vector<filesystem::path> files;
+  for ( auto& p : filesystem::recursive_directory_iterator(files_directory) ) {
+    if ( p.path().extension() == ".sig" ) {
+      files.push_back(p.path());
+    }
+  }
+  // chunks are filled in order of sorted file names, so they don't depend on loading order
+  std::sort(files.begin(), files.end());
+  // loaders parse points in parallel, router (this thread) gathers them into chunks per type,
+  // and each type's chunks are prepared and saved on its own writer thread.
+  // Points are passed with index of their file, point of not loaded file is nullptr
+  typedef std::pair<size_t, Point*> Loaded;
+  BlockingQueue<Loaded> loaded(2 * n);
+  std::atomic<size_t> next_file(0);
+  vector<std::thread> loaders;
+  for ( int t = 0; t < threads; ++t ) {
+    loaders.emplace_back([&] {
+      for ( size_t i = next_file++; i < files.size(); i = next_file++ ) {
+        Point* point = nullptr;
+        try {
+          point = LoadPoint(files[i].string(), files[i].stem().string());
+        }
+        catch ( std::exception &e ) {
+          std::cout << files[i] << ": " << e.what() << std::endl;
+        }
+        // queue is closed if router failed
+        if ( !loaded.Push(Loaded(i, point)) ) {
+          delete point;
+          return;
+        }
+      }
+    });
+  }
+
+  typedef std::pair<string, QVector<Point*> > Chunk;
+  map<string, BlockingQueue<Chunk>*> chunks;
   map<string, QVector<Point*> > samples;
   map<string, int> counters;
+  vector<std::thread> writers;
+  // the first exception of writers or router, it's rethrown when all threads are joined
+  std::exception_ptr error;
+  std::mutex error_mutex;
+  auto set_error = [&](std::exception_ptr e) {
+    std::lock_guard<std::mutex> lock(error_mutex);
+    if ( !error )
+      error = e;
+  };
   for ( auto t : types::TYPES ) {
-    samples[t] = QVector<Point*>();
+    chunks[t] = new BlockingQueue<Chunk>(2);
     counters[t] = 0;
+    BlockingQueue<Chunk>* queue = chunks[t];
+    writers.emplace_back([queue, &set_error] {
+      Chunk chunk;
+      bool failed = false;
+      // after a failure chunks are still popped, so router isn't blocked
+      while ( queue->Pop(&chunk) ) {
+        if ( !failed ) {
+          try {
+            SaveDataSet(chunk.second, chunk.first);
+          }
+          catch ( ... ) {
+            set_error(std::current_exception());
+            failed = true;
+          }
+        }
+        for ( auto s : chunk.second )
+          delete s;
+      }
+    });
   }
-  for ( auto& p : filesystem::recursive_directory_iterator(files_directory) ) {
-    if ( p.path().extension() != ".sig" ) {
-      continue;
+  auto dispatch = [&](const string &type) {
+    string name = datasets_directory + "/" + type + "/" + type + "_"
+                + dataset_name + std::to_string(++counters[type]) + ".db";
+    chunks[type]->Push(Chunk(name, samples[type]));
+    samples[type].clear();
+  };
+  auto route = [&](Point* sample) {
+    string type;
+    try {
+      type = sample->label(TYPE_DESCRIPTOR).toSingleValue().toStdString();
     }
-    for ( auto& pair : counters ) {
-      if ( pair.second % n == 0 && !samples[pair.first].empty() ) {
-        name = datasets_directory + pair.first + "/" + pair.first + "_"
-             + dataset_name + std::to_string(pair.second / n) + ".db";
-        SaveDataSet(samples[pair.first], name);
-        for ( auto s : samples[pair.first] )
-          delete s;
-        samples[pair.first].clear();
-        }
+    catch ( std::exception &e ) {
+      std::cout << sample->name().toStdString() << ": " << e.what() << std::endl;
+      delete sample;
+      return;
+    }
+    if ( chunks.find(type) == chunks.end() ) {
+      std::cout << sample->name().toStdString() << ": unknown type '" << type << "'" << std::endl;
+      delete sample;
+      return;
     }
-    Point* sample = LoadPoint(p.path().string(), p.path().stem());
-    type = sample->label(TYPE_DESCRIPTOR).toSingleValue().toStdString();
     samples[type] << sample;
-    ++counters[type];
-  }
-  for ( auto pair : samples ) {
-    if ( !pair.second.empty() ) {
-      name = datasets_directory + "/" + pair.first + "/" + pair.first + "_"
-           + dataset_name + std::to_string(pair.second.size() / n + 1) + ".db";
-      SaveDataSet(pair.second, name);
-      for ( auto s : pair.second )
-        delete s;
-      pair.second.clear();
+    if ( samples[type].size() == n ) {
+      dispatch(type);
+    }
+  };
+  // points loaded ahead of the next file wait here for their turn
+  map<size_t, Point*> pending;
+  size_t next_routed = 0;
+  try {
+    Loaded point;
+    while ( next_routed < files.size() && loaded.Pop(&point) ) {
+      pending[point.first] = point.second;
+      for ( auto p = pending.begin(); p != pending.end() && p->first == next_routed; p = pending.erase(p) ) {
+        ++next_routed;
+        if ( p->second )
+          route(p->second);
+      }
+    }
+    for ( auto t : types::TYPES ) {
+      if ( !samples[t].empty() ) {
+        dispatch(t);
       }
+    }
+  }
+  catch ( ... ) {
+    set_error(std::current_exception());
+  }
+  loaded.Close();
+  for ( auto &l : loaders ) {
+    l.join();
+  }
+  Loaded point;
+  while ( loaded.Pop(&point) ) {
+    delete point.second;
+  }
+  for ( auto &p : pending ) {
+    delete p.second;
+  }
+  for ( auto t : types::TYPES ) {
+    chunks[t]->Close();
+  }
+  for ( auto &w : writers ) {
+    w.join();
+  }
+  for ( auto &pair : chunks ) {
+    delete pair.second;
+  }
+  for ( auto &pair : samples ) {
+    for ( auto s : pair.second )
+      delete s;
+  }
+  if ( error ) {
+    std::rethrow_exception(error);
   }
 }
 
@@ -99,7 +222,8 @@ void ReCreateDirs(const string &root_directory) {
 }
 
 Point* LoadPoint(const string &file_name, const string &point_name) {
-  Point* point = new Point;
+  // point is freed if loading throws
+  std::unique_ptr<Point> point(new Point);
   point->load(QString::fromStdString(file_name));
   point->setName(QString::fromStdString(point_name));
   /* different codecs have different number and types of additional information, such tags,
@@ -109,19 +233,34 @@ Point* LoadPoint(const string &file_name, const string &point_name) {
     point->layout().filter(QStringList() << "*", tags);
     point->setLayout(point->layout());
   }*/
-  return point;
+  return point.release();
+}
+
+namespace {
+
+ParameterMap EnumerateParams() {
+  ParameterMap enumerate;
+  enumerate.insert("descriptorNames", QStringList() << "tonal.key*.key" << "tonal.*scale" << "highlevel.*.value");
+  return enumerate;
+}
+
+ParameterMap NormalizeParams() {
+  ParameterMap normalize;
+  normalize.insert("except", QStringList() << "lowlevel.mfcc*" << "highlevel*");
+  return normalize;
 }
 
+}  // namespace
+
 DataSet* PrepareDataSet(DataSet *dataset) {
-  gaia2::init();
+  InitGaia();
   // Params for transformations
-  ParameterMap enumerate, select_metadata, select_mfcc, select_highlevel, select_key, normalize;
-  enumerate.insert("descriptorNames", QStringList() << "tonal.key*.key" << "tonal.*scale" << "highlevel.*.value");
-  select_metadata.insert("descriptorNames", "metadata.tags.file_name");
+  ParameterMap enumerate = EnumerateParams(), normalize = NormalizeParams();
+  ParameterMap select_metadata, select_mfcc, select_highlevel, select_key;
+  select_metadata.insert("descriptorNames", QStringList() << FILENAME_DESCRIPTOR << DURATION_DESCRIPTOR);
   select_mfcc.insert("descriptorNames", QStringList() << "lowlevel.mfcc*");
   select_highlevel.insert("descriptorNames", QStringList() << "highlevel*");
   select_key.insert("descriptorNames", QStringList() << "tonal.key*.key" << "tonal.key*.scale");
-  normalize.insert("except", QStringList() << "lowlevel.mfcc*" << "highlevel*");
 
   // Reduce future dataset size by removing variable length descriptors,
   // fixing descriptors length and enumerating string descriptors
@@ -142,7 +281,7 @@ DataSet* PrepareDataSet(DataSet *dataset) {
   delete enumerated;
   DataSet* normalized = gaia2::transform(cleaned, "Normalize", normalize);
   delete cleaned;
-  DataSet* pca        = Pca(normalized, QStringList() << "lowlevel.mfcc*" << "highlevel*", 25);
+  DataSet* pca        = Pca(normalized, QStringList() << "lowlevel.mfcc*" << "highlevel*", PCA_DIMENSION);
   delete normalized;
 
   // Merge datasets
@@ -158,11 +297,25 @@ DataSet* PrepareDataSet(DataSet *dataset) {
   return result;
 }
 
+DataSet* NormalizeDataSet(DataSet *dataset) {
+  InitGaia();
+  DataSet* removed_vl   = gaia2::transform(dataset, "RemoveVL");
+  DataSet* fixed_length = gaia2::transform(removed_vl, "FixLength");
+  delete removed_vl;
+  DataSet* enumerated   = gaia2::transform(fixed_length, "Enumerate", EnumerateParams());
+  delete fixed_length;
+  DataSet* cleaned      = gaia2::transform(enumerated, "Cleaner");
+  delete enumerated;
+  DataSet* normalized   = gaia2::transform(cleaned, "Normalize", NormalizeParams());
+  delete cleaned;
+  return normalized;
+}
+
 DataSet* Pca(DataSet *dataset, const QStringList &except, int dimension) {
   ParameterMap pca_params;
   pca_params.insert("except", except);
   pca_params.insert("dimension", dimension);
-  pca_params.insert("resultName", "pca");
+  pca_params.insert("resultName", PCA_DESCRIPTOR);
   return gaia2::transform(dataset, "PCA", pca_params);
 }
 
@@ -179,13 +332,14 @@ DataSet* MergeDataSets(const vector<const DataSet*> &datasets) {
 }
 
 DataSet* SumDataSets(const vector<DataSet*> &datasets) {
-  DataSet* previous = datasets[0];
-  DataSet* result;
+  // sum is accumulated in a copy, so every intermediate dataset is owned here
+  DataSet* result = datasets[0]->copy();
   for ( int i = 1; i < static_cast<int>(datasets.size()); ++i ) {
-    result = SumDataSets(previous, datasets[i]);
-    if ( i > 1)
-      delete previous;
-    previous = result;
+    DataSet* sum = SumDataSets(result, datasets[i]);
+    // SumDataSets may append to 'result' in place
+    if ( sum != result )
+      delete result;
+    result = sum;
   }
   return result;
 }
@@ -199,8 +353,6 @@ DataSet* SumDataSets(DataSet *first, DataSet *second) {
   select_params.insert("descriptorNames", common_descriptors);
   DataSet* selected_first = first;
   DataSet* selected_second = second;
-  // first of all - delete intersection of points from one of datasets
-  selected_second->removePoints(points_intersection);
   bool free = false;
   if ( first->layout().descriptorNames() != common_descriptors ) {
     selected_first  = gaia2::transform(first, "Select", select_params);
@@ -209,6 +361,14 @@ DataSet* SumDataSets(DataSet *first, DataSet *second) {
     selected_second = gaia2::transform(second, "Select", select_params);
     free = true;
   }
+  // delete intersection of points from one of datasets, but don't change 'second' itself
+  if ( !points_intersection.empty() ) {
+    if ( !free ) {
+      selected_second = second->copy();
+      free = true;
+    }
+    selected_second->removePoints(points_intersection);
+  }
   selected_first->forgetHistory();
   selected_second->forgetHistory();
   selected_first->appendDataSet(selected_second);
@@ -20,6 +20,10 @@ namespace util {
 using gaia2::Point;
 using gaia2::DataSet;
 struct Concatenate;
+/**
+ * @brief InitGaia Initializes gaia2 once per process, may be called from any thread.
+ */
+void InitGaia();
 /**
  * @brief ConcatenateDataSets Concatenate datasets from 'datasets_directory' and save result dataset as 'dataset_name'.
  * @param datasets_directory Directory with datasets.
@@ -34,11 +38,16 @@ void ConcatenateDataSets(const string &datasets_directory = DATASETS_DIR,
  * @param datasets_directory Directory with datasets parts.
  * @param dataset_name Name of the created dataset.
  * @param samples_per_dataset Number of samples in dataset chunk.
+ * @param threads Number of threads loading files (0 - number of hardware threads).
+ * @note Files are loaded concurrently, but chunks are filled in order of sorted file names, so they are the same
+ *  on every run. Chunks of every type are prepared and saved on separate threads, while loading goes on.
+ *  The first exception thrown while saving chunks is rethrown when all threads are finished.
  */
 void MergeFiles(const string &files_directory = DESCRIPTORS_DIR,
                 const string &datasets_directory = DATASETS_DIR,
                 const string &dataset_name = USER_DATASET_PART,
-                const int samples_per_dataset = SAMPLES_PER_DATASET);
+                const int samples_per_dataset = SAMPLES_PER_DATASET,
+                int threads = 0);
 /**
  * SaveDataSetPart Creates dataset from 'samples' and save it as 'dataset_name'.
  */
@@ -52,6 +61,11 @@ void ReCreateDirs(const string &root_directory);
 Point* LoadPoint(const string &file_name, const string &point_name);
 
 DataSet* PrepareDataSet(DataSet *dataset);
+/**
+ * NormalizeDataSet Applies transformations which PrepareDataSet does before PCA (RemoveVL, FixLength,
+ * Enumerate, Cleaner, Normalize). History of the result maps raw points to the same space.
+ */
+DataSet* NormalizeDataSet(DataSet *dataset);
 
 DataSet* Pca(DataSet *dataset, const QStringList &except, int dimension);
 /**
@@ -61,10 +75,14 @@ DataSet* Pca(DataSet *dataset, const QStringList &except, int dimension);
 DataSet* MergeDataSets(const vector<const DataSet*> &datasets);
 /**
  * SumDataSets Sums datasets. The result dataset contains only intersection of there descriptors.
+ * @note 'datasets' are not changed, the result is a new dataset owned by caller.
  */
 DataSet* SumDataSets(const vector<DataSet*> &datasets);
 /**
  * SumDataSets Sums two datasets. The result dataset contains only intersection of there descriptors.
+ * @note 'second' is not changed, but the result may be 'first' with appended points (then 'first' is changed
+ * in place), otherwise it's a new dataset and 'first' is left as it was.
+ * Use DataSetUnion to search in several datasets without copying them.
  */
 DataSet* SumDataSets(DataSet *first, DataSet *second);
 /**
@@ -1,9 +1,20 @@
 #include "audiq_app.h"
+#include <mutex>
+#include <sstream>
 #include "essentia/essentia.h"
 #include "essentia/algorithmfactory.h"
 #include "gaia2/gaia.h"
 #include "audiq/audiq.h"
+#include "audiq/audiq_util.h"
 #include "audiq/audiq_processing.h"
+#include "audiq/audiq_simd.h"
+#include "audiq/audiq_server.h"
+#include "audiq/audiq_catalog.h"
+#include "audiq/audiq_shards.h"
+#include "audiq/audiq_knn_graph.h"
+#include "audiq/audiq_file_recommender.h"
+#include "audiq/audiq_streaming_build.h"
+#include "audiq/audiq_result_sink.h"
 
 using audiq::Audiq;
 using namespace std;
@@ -12,7 +23,7 @@ using namespace essentia;
 Audiq::Audiq() {
   declareParameters();
   essentia::init();
-  gaia2::init();
+  audiq::util::InitGaia();
 }
 
 void Audiq::declareParameters() {
@@ -31,6 +42,22 @@ void Audiq::declareParameters() {
   declareParameter("weight_lowlevel", "Weight corresponding to lowlevel component in metric used bu audiq", "(0, 10)", 1.0);
   declareParameter("weight_timbre", "Weight corresponding to timbre component in metric used bu audiq", "(0, 10)", 1.0);
   declareParameter("weight_highlevel", "Weight corresponding to highlevel component in metric used bu audiq", "(0, 10)", 1.0);
+  declareParameter("quantization", "Search on quantized global dataset descriptors", "{none, fp16, int8, pq}", "none");
+  declareParameter("rerank_candidates", "Number of quantized search candidates reranked with exact metric", "[0, inf)", 200);
+  declareParameter("report_recall", "Print recall of approximate search", "{true, false}", false);
+  declareParameter("index", "Take candidates from HNSW index of global dataset", "{true, false}", false);
+  declareParameter("index_ef", "Size of HNSW dynamic candidates list", "[1, inf)", 400);
+  declareParameter("threads", "Number of search threads, 0 - number of hardware threads", "[0, inf)", 0);
+  declareParameter("memory_limit", "Megabytes used by concurrent recommendation of types in many dataset mode and by loaded points of streaming build, 0 - no limit (default budget for streaming build)", "[0, inf)", 0);
+  declareParameter("shards", "Number of shards of global datasets searched by this process, 0 - not splitted datasets", "[0, inf)", 0);
+  declareParameter("shard_sockets", "Comma separated sockets of audiq processes serving shards of global datasets", "", "");
+  declareParameter("filter", "Recommend only samples matching filter 'LABEL=VALUE ... duration=MIN:MAX'", "", "");
+  declareParameter("collapse_duplicates", "Recommend one representative of every cluster of near-duplicate samples", "{true, false}", false);
+  declareParameter("pipeline", "Recommend for every sample as soon as it's extracted, without creating user datasets (global datasets must be built by streaming build)", "{true, false}", false);
+  declareParameter("result_format", "Result file format: names - YAML of similar samples written after search, yaml, jsonl or binary - results of every sample with distances streamed as soon as they are found", "{names, yaml, jsonl, binary}", "names");
+  declareParameter("knn_neighbours", "Number of neighbours kept in kNN graphs of global datasets (built with --knn-graphs), 0 - serve without graphs", "[0, inf)", 0);
+  declareParameter("simd", "Instruction set of native metric kernels", "{auto, scalar, avx2, avx512}", "auto");
+  declareParameter("validate_metric", "Compare native metric against gaia2 before search", "{true, false}", false);
 }
 
 void Audiq::configure() {
@@ -47,6 +74,22 @@ void Audiq::configure() {
   _weight_lowlevel = parameter("weight_lowlevel").toFloat();
   _weight_timbre = parameter("weight_timbre").toFloat();
   _weight_highlevel = parameter("weight_highlevel").toFloat();
+  _quantization = parameter("quantization").toString();
+  _rerank_candidates = parameter("rerank_candidates").toInt();
+  _report_recall = parameter("report_recall").toBool();
+  _index = parameter("index").toBool();
+  _index_ef = parameter("index_ef").toInt();
+  _threads = parameter("threads").toInt();
+  _memory_limit = parameter("memory_limit").toInt();
+  _shards = parameter("shards").toInt();
+  _knn_neighbours = parameter("knn_neighbours").toInt();
+  _shard_sockets = parameter("shard_sockets").toString();
+  _filter = parameter("filter").toString();
+  _result_format = parameter("result_format").toString();
+  _simd = parameter("simd").toString();
+  _validate_metric = parameter("validate_metric").toBool();
+  _collapse_duplicates = parameter("collapse_duplicates").toBool();
+  _pipeline = parameter("pipeline").toBool();
   if ( parameter("samples_directory").isConfigured() ) {
     _samples_directory = parameter("samples_directory").toString();
   }
@@ -55,6 +98,19 @@ void Audiq::configure() {
   if ( parameter("audiq_profile").isConfigured() ) {
     SetOptions(parameter("audiq_profile").toString());
   }
+  SetCommandLineOptions();
+}
+
+void Audiq::SetCommandLineOptions() {
+  // options enabled by command line flags aren't overridden by profile
+  Pool command_line;
+  if ( _pipeline ) {
+    command_line.set("pipeline", true);
+  }
+  if ( !_filter.empty() ) {
+    command_line.set("filter", _filter);
+  }
+  _options.merge(command_line, "replace");
 }
 
 void Audiq::SetDefaultOptions() {
@@ -71,6 +127,22 @@ void Audiq::SetDefaultOptions() {
   _options.set("weight_lowlevel", _weight_lowlevel);
   _options.set("weight_timbre", _weight_timbre);
   _options.set("weight_highlevel", _weight_highlevel);
+  _options.set("quantization", _quantization);
+  _options.set("rerank_candidates", _rerank_candidates);
+  _options.set("report_recall", _report_recall);
+  _options.set("index", _index);
+  _options.set("index_ef", _index_ef);
+  _options.set("validate_metric", _validate_metric);
+  _options.set("collapse_duplicates", _collapse_duplicates);
+  _options.set("pipeline", _pipeline);
+  _options.set("threads", _threads);
+  _options.set("memory_limit", _memory_limit);
+  _options.set("shards", _shards);
+  _options.set("knn_neighbours", _knn_neighbours);
+  _options.set("shard_sockets", _shard_sockets);
+  _options.set("filter", _filter);
+  _options.set("result_format", _result_format);
+  _options.set("simd", _simd);
 }
 
 void Audiq::SetOptions(string file_name) {
@@ -83,10 +155,7 @@ void Audiq::SetOptions(string file_name) {
   _options.merge(opts, "replace");
 }
 
-void Audiq::Start() {
-  bool dataset_mode = false;
-  if ( _options.value<string>("dataset_mode").compare("one") == 0 )
-    dataset_mode = true;
+void Audiq::ProcessSamples() {
   if ( !_only_recommendation ) {
   processing::SamplesToDataSet(_samples_directory,
                                _options.value<string>("descriptors_directory"),
@@ -97,17 +166,264 @@ void Audiq::Start() {
                                _options.value<string>("datasets_parts_directory"),
                                _options.value<string>("user_dataset_name"));
   }
+  similarity::SetIsa(similarity::IsaFromString(_options.value<string>("simd")));
+}
+
+void Audiq::Start() {
+  bool dataset_mode = false;
+  if ( _options.value<string>("dataset_mode").compare("one") == 0 )
+    dataset_mode = true;
+  mutex result_mutex;
+  _similar_samples.clear();
+  if ( RecommendPipelined([&](const string &target, const vector<similarity::Recommendation> &similar) {
+         lock_guard<mutex> lock(result_mutex);
+         for ( const auto &r : similar ) {
+           _similar_samples[target].push_back(r.file_name);
+         }
+       }) ) {
+    return;
+  }
+  ProcessSamples();
+  if ( _options.value<Real>("shards") > 0 || !_options.value<string>("shard_sockets").empty() ) {
+    _similar_samples = RecommendSharded(dataset_mode);
+    return;
+  }
   _similar_samples =  Recommend(dataset_mode, _options.value<string>("global_dataset_name"),
-                                _options.value<string>("user_dataset_name"), {
-                                  _options.value<float>("weight_lowlevel"),
-                                  _options.value<float>("weight_timbre"),
-                                  _options.value<float>("weight_highlevel") });
+                                _options.value<string>("user_dataset_name"), GetWeights(), GetSearchOptions());
+}
+
+bool Audiq::StartStreaming(const string &file_name, bool print) {
+  if ( !IsResultFormat(_options.value<string>("result_format")) ) {
+    return false;
+  }
+  if ( _options.value<Real>("shards") > 0 || !_options.value<string>("shard_sockets").empty() ) {
+    cout << "Result of sharded search isn't streamed, it's written as names" << endl;
+    return false;
+  }
+  ResultSink* sink = CreateResultSink(_options.value<string>("result_format"), file_name);
+  if ( !sink ) {
+    cout << "Can't write result file " << file_name << endl;
+    return true;
+  }
+  mutex print_mutex;
+  similarity::RecommendationHandler handler = [&](const string &target,
+                                                  const vector<similarity::Recommendation> &similar) {
+    sink->Write(target, similar);
+    if ( print ) {
+      lock_guard<mutex> lock(print_mutex);
+      cout << target << " :" << endl;
+      for ( const auto &r : similar ) {
+        cout << "   " << r.file_name << "   " << r.distance << endl;
+      }
+      cout << endl;
+    }
+  };
+  if ( !RecommendPipelined(handler) ) {
+    ProcessSamples();
+    StreamRecommend(_options.value<string>("dataset_mode") == "one", _options.value<string>("global_dataset_name"),
+                    _options.value<string>("user_dataset_name"), GetWeights(), handler, GetSearchOptions());
+  }
+  delete sink;
+  return true;
+}
+
+bool Audiq::RecommendPipelined(const similarity::RecommendationHandler &handler) {
+  if ( !GetFlag("pipeline") || _only_recommendation || _options.value<Real>("shards") > 0
+       || !_options.value<string>("shard_sockets").empty() ) {
+    return false;
+  }
+  similarity::SearchOptions search_options = GetSearchOptions();
+  similarity::SetIsa(similarity::IsaFromString(_options.value<string>("simd")));
+  FileRecommender files(_options.value<string>("extractor_profile"), _options.value<string>("svm_models_directory"));
+  if ( !files.Load(_options.value<string>("global_dataset_name"), search_options) ) {
+    cout << "There are no streaming built global datasets " << _options.value<string>("global_dataset_name")
+         << ", samples are processed without pipeline" << endl;
+    return false;
+  }
+  int recommended = files.StreamSamples(_samples_directory, GetWeights(), search_options, handler);
+  cout << "Recommended for " << recommended << " samples" << endl;
+  return true;
+}
+
+string Audiq::GetResultFormat() {
+  return _options.value<string>("result_format");
+}
+
+audiq::types::audiq_similar Audiq::RecommendSharded(bool one_dataset) {
+  similarity::SearchOptions search_options = GetSearchOptions();
+  vector<Shard*> shards;
+  for ( int i = 0; i < _options.value<Real>("shards"); ++i ) {
+    shards.push_back(new LocalShard(ShardName(_options.value<string>("global_dataset_name"), i), search_options));
+  }
+  istringstream sockets(_options.value<string>("shard_sockets"));
+  string socket_path;
+  while ( getline(sockets, socket_path, ',') ) {
+    if ( !socket_path.empty() ) {
+      shards.push_back(new RemoteShard(socket_path));
+    }
+  }
+  types::audiq_similar similar = ScatterGather(shards, one_dataset, _options.value<string>("user_dataset_name"),
+                                               GetWeights(), search_options);
+  for ( auto shard : shards ) {
+    delete shard;
+  }
+  return similar;
+}
+
+int Audiq::KnnNeighbours() {
+  return _options.value<Real>("knn_neighbours") > 0 ? _options.value<Real>("knn_neighbours") : KNN_K;
+}
+
+audiq::types::audiq_similar Audiq::MoreLikeThis(const string &sample) {
+  types::audiq_similar similar;
+  for ( auto t : types::TYPES ) {
+    string name = _options.value<string>("global_dataset_name") + "_" + t;
+    if ( !filesystem::exists(name + ".db") ) {
+      continue;
+    }
+    similarity::KnnGraph* graph = similarity::LoadDataSetKnnGraph(name, KnnNeighbours(),
+                                                                  similarity::MetricWeights(GetWeights()));
+    if ( !graph ) {
+      cout << "kNN graph of " << name << " isn't built or is outdated (see --knn-graphs)" << endl;
+      continue;
+    }
+    vector<pair<string, float> > neighbours = graph->Lookup(sample,
+                                                            _options.value<Real>("recommended_samples_number"));
+    delete graph;
+    if ( !neighbours.empty() ) {
+      for ( const auto &n : neighbours ) {
+        similar[sample].push_back(n.first);
+      }
+      break;
+    }
+  }
+  return similar;
+}
+
+bool Audiq::BuildKnnGraphs() {
+  similarity::SetIsa(similarity::IsaFromString(_options.value<string>("simd")));
+  bool built = false;
+  for ( auto t : types::TYPES ) {
+    string name = _options.value<string>("global_dataset_name") + "_" + t;
+    if ( !filesystem::exists(name + ".db") ) {
+      continue;
+    }
+    if ( !similarity::BuildDataSetKnnGraph(name, KnnNeighbours(), similarity::MetricWeights(GetWeights()),
+                                           _options.value<Real>("threads")) ) {
+      cout << "Can't save kNN graph of " << name << endl;
+      return false;
+    }
+    cout << "kNN graph of " << name << " is built" << endl;
+    built = true;
+  }
+  return built;
+}
+
+audiq::types::audiq_similar Audiq::RecommendForFile(const string &file_name) {
+  similarity::SearchOptions search_options = GetSearchOptions();
+  similarity::SetIsa(similarity::IsaFromString(_options.value<string>("simd")));
+  FileRecommender files(_options.value<string>("extractor_profile"), _options.value<string>("svm_models_directory"));
+  if ( !files.Load(_options.value<string>("global_dataset_name"), search_options) ) {
+    cout << "There are no streaming built global datasets " << _options.value<string>("global_dataset_name") << endl;
+    return types::audiq_similar();
+  }
+  return files.RecommendForFile(file_name, GetWeights(), search_options);
+}
+
+void Audiq::BuildGlobalDataSets() {
+  string descriptors_directory = _options.value<string>("descriptors_directory");
+  // descriptors of previous session aren't mixed into global datasets
+  if ( filesystem::exists(filesystem::path(descriptors_directory)) )
+    filesystem::remove_all(descriptors_directory);
+  processing::ProcessSamples(_samples_directory, _options.value<string>("extractor_profile"), descriptors_directory,
+                             _options.value<string>("svm_models_directory"));
+  int memory_limit = _options.value<Real>("memory_limit");
+  util::StreamingBuildDataSets(descriptors_directory, _options.value<string>("global_dataset_name"),
+                               memory_limit > 0 ? memory_limit : STREAMING_MEMORY_BUDGET);
+}
+
+void Audiq::SplitGlobalDataSet(int shards) {
+  SplitDataSet(_options.value<string>("global_dataset_name"), shards);
+}
+
+void Audiq::Sweep(const vector<vector<float> > &weights) {
+  bool dataset_mode = _options.value<string>("dataset_mode").compare("one") == 0;
+  ProcessSamples();
+  _sweep_similar_samples = RecommendSweep(dataset_mode, _options.value<string>("global_dataset_name"),
+                                          _options.value<string>("user_dataset_name"), weights,
+                                          GetSearchOptions());
+}
+
+void Audiq::Serve(const string &socket_path) {
+  similarity::SearchOptions search_options = GetSearchOptions();
+  similarity::SetIsa(similarity::IsaFromString(_options.value<string>("simd")));
+  similarity::Catalog catalog;
+  // streaming built global datasets can answer single file requests only
+  FileRecommender files(_options.value<string>("extractor_profile"), _options.value<string>("svm_models_directory"));
+  bool files_loaded = files.Load(_options.value<string>("global_dataset_name"), search_options);
+  if ( !catalog.Load(_options.value<string>("global_dataset_name"), search_options) && !files_loaded ) {
+    cout << "There are no global datasets " << _options.value<string>("global_dataset_name") << endl;
+    return;
+  }
+  if ( _options.value<Real>("knn_neighbours") > 0
+       && !catalog.LoadKnnGraphs(_options.value<Real>("knn_neighbours"), GetWeights()) ) {
+    cout << "Can't load kNN graphs of " << _options.value<string>("global_dataset_name")
+         << ", they aren't built or are outdated (see --knn-graphs)" << endl;
+  }
+  cout << "Catalog loaded: " << catalog.Bytes() << " bytes" << endl;
+  ServerConfig config;
+  config.socket_path = socket_path;
+  config.threads = _options.value<Real>("threads");
+  config.one_dataset = _options.value<string>("dataset_mode").compare("one") == 0;
+  config.weights = GetWeights();
+  config.search_options = search_options;
+  config.extractor_profile = _options.value<string>("extractor_profile");
+  config.models_directory = _options.value<string>("svm_models_directory");
+  config.samples_in_dataset = _options.value<Real>("samples_in_dataset");
+  Server server(catalog, config, files_loaded ? &files : nullptr);
+  server.Run();
+}
+
+audiq::similarity::SearchOptions Audiq::GetSearchOptions() {
+  similarity::SearchOptions search_options;
+  search_options.quantity = _options.value<Real>("recommended_samples_number");
+  search_options.quantization = similarity::QuantizationFromString(_options.value<string>("quantization"));
+  search_options.rerank = _options.value<Real>("rerank_candidates");
+  search_options.report_recall = GetFlag("report_recall");
+  search_options.index = GetFlag("index");
+  search_options.index_ef = _options.value<Real>("index_ef");
+  search_options.validate = GetFlag("validate_metric");
+  search_options.threads = _options.value<Real>("threads");
+  search_options.memory_limit = _options.value<Real>("memory_limit");
+  search_options.collapse_duplicates = GetFlag("collapse_duplicates");
+  if ( !similarity::ParseSampleFilter(_options.value<string>("filter"), &search_options.filter) ) {
+    cout << "Wrong filter '" << _options.value<string>("filter") << "', samples aren't filtered" << endl;
+  }
+  return search_options;
+}
+
+bool Audiq::GetFlag(const string &name) {
+  // defaults are stored as numbers, YamlInput reads true/false of profile as strings
+  if ( _options.contains<string>(name) ) {
+    return _options.value<string>(name) == "true";
+  }
+  return _options.value<Real>(name) != 0;
+}
+
+vector<float> Audiq::GetWeights() {
+  return { _options.value<float>("weight_lowlevel"),
+           _options.value<float>("weight_timbre"),
+           _options.value<float>("weight_highlevel") };
 }
 
 audiq::types::audiq_similar Audiq::GetResult() {
   return _similar_samples;
 }
 
+vector<audiq::types::audiq_similar> Audiq::GetSweepResult() {
+  return _sweep_similar_samples;
+}
+
 string Audiq::GetMode() {
   return _dataset_mode;
 }
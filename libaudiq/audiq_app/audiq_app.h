@@ -8,6 +8,8 @@
 #include "essentia/pool.h"
 #include "essentia/configurable.h"
 #include "audiq/audiq_types.h"
+#include "audiq/audiq_search_options.h"
+#include "audiq/audiq_similarity_model.h"
 
 namespace audiq {
 
@@ -19,11 +21,73 @@ class Audiq: public essentia::Configurable {
    void declareParameters();
    void SetDefaultOptions();
    void SetOptions(std::string file_name);
+   /**
+    * SetCommandLineOptions Sets options given by command line over options of profile.
+    */
+   void SetCommandLineOptions();
    void Start();
+   /**
+    * StartStreaming Same as Start, but results are written to 'file_name' with audiq::ResultSink as soon as
+    * they are found (and printed if 'print' is set). Returns false if "result_format" isn't streamed one
+    * (or search is sharded), then nothing is done.
+    */
+   bool StartStreaming(const std::string &file_name, bool print);
+   /**
+    * Sweep Same as Start, but recommends for every weights triple of 'weights' in one pass.
+    */
+   void Sweep(const std::vector<std::vector<float> > &weights);
+   /**
+    * Serve Loads global datasets once and answers requests on unix socket 'socket_path' (see audiq::Server).
+    */
+   void Serve(const std::string &socket_path);
+   /**
+    * MoreLikeThis Returns the most similar samples to 'sample' of global datasets (point name or file name)
+    * from kNN graphs of global datasets (see BuildKnnGraphs), graphs which aren't built or are outdated are skipped.
+    */
+   types::audiq_similar MoreLikeThis(const std::string &sample);
+   /**
+    * BuildKnnGraphs Builds (or updates) kNN graphs of global datasets with "knn_neighbours" neighbours
+    * (KNN_K if it's 0) and weights of audiq, returns false on failure or if there are no global datasets.
+    */
+   bool BuildKnnGraphs();
+   /**
+    * RecommendForFile Returns the most similar samples of global datasets to audio file 'file_name'
+    * without creating user datasets (see audiq::FileRecommender).
+    */
+   types::audiq_similar RecommendForFile(const std::string &file_name);
+   /**
+    * BuildGlobalDataSets Extracts descriptors of samples of "samples_directory" and builds global datasets from them
+    * with streaming build (see util::StreamingBuildDataSets), loaded points take at most "memory_limit" megabytes.
+    */
+   void BuildGlobalDataSets();
+   /**
+    * SplitGlobalDataSet Splits global datasets into 'shards' shards (see audiq::SplitDataSet).
+    */
+   void SplitGlobalDataSet(int shards);
    types::audiq_similar GetResult();
+   std::vector<types::audiq_similar> GetSweepResult();
    std::string GetMode();
+   std::string GetResultFormat();
 
  private:
+   void ProcessSamples();
+   /**
+    * RecommendPipelined Recommends for samples of "samples_directory" with FileRecommender::StreamSamples,
+    * if "pipeline" is set and global datasets were built by streaming build. Returns false if it wasn't done.
+    */
+   bool RecommendPipelined(const similarity::RecommendationHandler &handler);
+   types::audiq_similar RecommendSharded(bool one_dataset);
+   similarity::SearchOptions GetSearchOptions();
+   std::vector<float> GetWeights();
+   /**
+    * KnnNeighbours Number of neighbours of kNN graphs: "knn_neighbours" or KNN_K if it's 0.
+    */
+   int KnnNeighbours();
+   /**
+    * GetFlag Returns boolean option 'name' (default or set by profile).
+    */
+   bool GetFlag(const std::string &name);
+
    std::string _samples_directory;
    std::string _global_dataset_name;
    std::string _user_dataset_name;
@@ -33,16 +97,33 @@ class Audiq: public essentia::Configurable {
    std::string _svm_models_directory;
    std::string _extractor_profile;
    std::string _dataset_mode;
+   std::string _quantization;
+   std::string _simd;
+   std::string _shard_sockets;
+   std::string _filter;
+   std::string _result_format;
 
    bool _only_recommendation;
+   bool _report_recall;
+   bool _index;
+   bool _validate_metric;
+   bool _collapse_duplicates;
+   bool _pipeline;
 
    int _samples_in_dataset;
    int _recommended_samples_number;
+   int _rerank_candidates;
+   int _index_ef;
+   int _threads;
+   int _memory_limit;
+   int _shards;
+   int _knn_neighbours;
    float _weight_lowlevel;
    float _weight_timbre;
    float _weight_highlevel;
 
    types::audiq_similar _similar_samples;
+   std::vector<types::audiq_similar> _sweep_similar_samples;
    essentia::Pool _options;
 };
 